@@ -0,0 +1,487 @@
+#include "allocator.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ----- default_allocator -----
+
+static void* default_alloc(void* context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+static void* default_realloc(void* context, void* pointer, size_t old_size, size_t new_size) {
+    (void)context;
+    (void)old_size;
+    return realloc(pointer, new_size);
+}
+
+static void default_free(void* context, void* pointer) {
+    (void)context;
+    free(pointer);
+}
+
+Allocator default_allocator = {default_alloc, default_realloc, default_free, NULL};
+
+void* allocator_alloc(Allocator* allocator, size_t size) {
+    return allocator->alloc(allocator->context, size);
+}
+
+void* allocator_calloc(Allocator* allocator, size_t amt, size_t size) {
+    if (allocator == &default_allocator) return calloc(amt, size);
+    if (size > 0 && amt > SIZE_MAX / size) return NULL;
+
+    void* result = allocator->alloc(allocator->context, amt * size);
+    if (result != NULL) memset(result, 0, amt * size);
+    return result;
+}
+
+void* allocator_realloc(Allocator* allocator, void* pointer, size_t old_size, size_t new_size) {
+    return allocator->realloc(allocator->context, pointer, old_size, new_size);
+}
+
+void allocator_free(Allocator* allocator, void* pointer) {
+    allocator->free(allocator->context, pointer);
+}
+
+// ----- Arena -----
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+// returns: NULL if the system is out of memory
+static ArenaChunk* new_chunk(size_t size, ArenaChunk* next) {
+    if (size > SIZE_MAX - sizeof(ArenaChunk)) return NULL;
+
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL) return NULL;
+    chunk->next = next;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void* arena_alloc(void* context, size_t size) {
+    Arena* arena = context;
+    if (size > SIZE_MAX - ARENA_ALIGNMENT) return NULL;
+    size = align_up(size);
+
+    ArenaChunk* chunk = arena->current;
+    if (chunk->size - chunk->used < size) {
+        if (chunk->next != NULL && chunk->next->size >= size) {
+            // a chunk that was released earlier
+            chunk = chunk->next;
+            chunk->used = 0;
+        } else {
+            size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+            ArenaChunk* added = new_chunk(chunk_size, chunk->next);
+            if (added == NULL) return NULL;
+            chunk->next = added;
+            chunk = added;
+        }
+        arena->current = chunk;
+    }
+
+    void* result = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->last = result;
+    return result;
+}
+
+static void* arena_realloc(void* context, void* pointer, size_t old_size, size_t new_size) {
+    Arena* arena = context;
+    ArenaChunk* chunk = arena->current;
+
+    // the latest allocation can grow in place while its chunk has room
+    if (pointer != NULL && pointer == arena->last && new_size <= SIZE_MAX - ARENA_ALIGNMENT) {
+        size_t start = (char*)pointer - chunk->data;
+        if (chunk->size - start >= align_up(new_size)) {
+            chunk->used = start + align_up(new_size);
+            return pointer;
+        }
+    }
+
+    void* result = arena_alloc(context, new_size);
+    if (result == NULL) return NULL;
+    if (pointer != NULL) memcpy(result, pointer, old_size < new_size ? old_size : new_size);
+    return result;
+}
+
+static void arena_free_pointer(void* context, void* pointer) {
+    Arena* arena = context;
+
+    if (pointer != NULL && pointer == arena->last) {
+        arena->current->used = (char*)pointer - arena->current->data;
+        arena->last = NULL;
+    }
+}
+
+Arena* arena_new(size_t chunk_size) {
+    Arena* arena = malloc(sizeof(Arena));
+    arena->allocator.alloc = arena_alloc;
+    arena->allocator.realloc = arena_realloc;
+    arena->allocator.free = arena_free_pointer;
+    arena->allocator.context = arena;
+    arena->chunk_size = align_up(chunk_size);
+    arena->first = new_chunk(arena->chunk_size, NULL);
+    arena->current = arena->first;
+    arena->last = NULL;
+    return arena;
+}
+
+Allocator* arena_allocator(Arena* arena) {
+    return &arena->allocator;
+}
+
+ArenaMark arena_mark(Arena* arena) {
+    ArenaMark mark = {arena->current, arena->current->used};
+    return mark;
+}
+
+void arena_release(Arena* arena, ArenaMark mark) {
+    // oversized chunks after the mark are freed, the others are kept for the next allocations
+    ArenaChunk** link = &mark.chunk->next;
+    while (*link != NULL) {
+        ArenaChunk* chunk = *link;
+        if (chunk->size > arena->chunk_size) {
+            *link = chunk->next;
+            free(chunk);
+        } else {
+            link = &chunk->next;
+        }
+    }
+
+    arena->current = mark.chunk;
+    arena->current->used = mark.used;
+    arena->last = NULL;
+}
+
+void arena_reset(Arena* arena) {
+    ArenaMark start = {arena->first, 0};
+    arena_release(arena, start);
+}
+
+void arena_free(Arena* arena) {
+    ArenaChunk* chunk = arena->first;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+// ----- Pool -----
+
+// size class of blocks that come from malloc instead of a slab
+#define POOL_LARGE_CLASS POOL_CLASS_AMT
+
+// bytes of blocks taken from the system at once, for the small classes
+#define POOL_SLAB_SIZE (64 * 1024)
+#define POOL_MIN_SLAB_BLOCKS 4
+
+// bytes of blocks moved between a cache and the pool at once
+#define POOL_BATCH_BYTES (16 * 1024)
+#define POOL_MAX_BATCH 64
+
+struct PoolSlab {
+    PoolSlab* next;
+    _Alignas(max_align_t) char data[];
+};
+
+struct PoolLargeBlock {
+    PoolLargeBlock* previous;
+    PoolLargeBlock* next;
+    size_t reserved;
+    uint64_t unused;  // keeps the block behind the header aligned
+    PoolHeader header;
+};
+
+_Static_assert(sizeof(PoolHeader) % _Alignof(max_align_t) == 0, "Blocks behind headers have to stay aligned");
+_Static_assert(sizeof(PoolLargeBlock) % _Alignof(max_align_t) == 0, "Blocks behind headers have to stay aligned");
+
+// classes grow by 16 bytes up to 128, then in four steps per doubling
+static size_t pool_class_of(size_t size) {
+    if (size <= 128) return size == 0 ? 0 : (size - 1) >> 4;
+
+    size_t bits = 63 - __builtin_clzll(size - 1);
+    return 4 + (bits - 7) * 4 + ((size - 1) >> (bits - 2));
+}
+
+static size_t pool_class_size(size_t size_class) {
+    if (size_class < 8) return (size_class + 1) * 16;
+
+    size_t doubling = (size_class - 8) / 4;
+    size_t step = (size_class - 8) % 4;
+    return ((size_t)1 << (7 + doubling)) + ((step + 1) << (5 + doubling));
+}
+
+static size_t pool_batch_amt(size_t size_class) {
+    size_t amt = POOL_BATCH_BYTES / pool_class_size(size_class);
+    if (amt < 2) return 2;
+    return amt > POOL_MAX_BATCH ? POOL_MAX_BATCH : amt;
+}
+
+static PoolHeader* header_of(void* pointer) {
+    return (PoolHeader*)pointer - 1;
+}
+
+static void* block_of(PoolHeader* header) {
+    return header + 1;
+}
+
+// free blocks are linked through their first word
+static PoolHeader** next_free(PoolHeader* header) {
+    return block_of(header);
+}
+
+static void pool_add_reserved(Pool* pool, size_t bytes) {
+    pool->reserved += bytes;
+    if (pool->reserved > pool->peak_reserved) pool->peak_reserved = pool->reserved;
+}
+
+// cuts a new slab into free blocks of the class. Only called while holding the lock
+// returns: false if the slab couldn't be allocated
+static bool pool_add_slab(Pool* pool, size_t size_class) {
+    size_t block_size = sizeof(PoolHeader) + pool_class_size(size_class);
+    size_t amt = POOL_SLAB_SIZE / block_size;
+    if (amt < POOL_MIN_SLAB_BLOCKS) amt = POOL_MIN_SLAB_BLOCKS;
+
+    PoolSlab* slab = malloc(sizeof(PoolSlab) + amt * block_size);
+    if (slab == NULL) return false;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool_add_reserved(pool, amt * block_size);
+
+    for (size_t i = amt; i > 0; --i) {
+        PoolHeader* header = (PoolHeader*)(slab->data + (i - 1) * block_size);
+        header->size_class = size_class;
+        *next_free(header) = pool->free_blocks[size_class];
+        pool->free_blocks[size_class] = header;
+    }
+    pool->free_amt[size_class] += amt;
+    return true;
+}
+
+// moves a batch of free blocks from the pool to the cache, or what's left without a new slab
+// returns: false if not a single block could be moved
+static bool pool_cache_refill(PoolCache* cache, size_t size_class) {
+    Pool* pool = cache->pool;
+    size_t amt = pool_batch_amt(size_class);
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free_amt[size_class] < amt && !pool_add_slab(pool, size_class)) {
+        amt = pool->free_amt[size_class];
+    }
+
+    for (size_t i = 0; i < amt; ++i) {
+        PoolHeader* header = pool->free_blocks[size_class];
+        pool->free_blocks[size_class] = *next_free(header);
+        *next_free(header) = cache->free_blocks[size_class];
+        cache->free_blocks[size_class] = header;
+    }
+    pool->free_amt[size_class] -= amt;
+    cache->free_amt[size_class] += amt;
+    pthread_mutex_unlock(&pool->lock);
+    return amt > 0;
+}
+
+// moves 'amt' free blocks from the cache back to the pool
+static void pool_cache_return(PoolCache* cache, size_t size_class, size_t amt) {
+    Pool* pool = cache->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    for (size_t i = 0; i < amt; ++i) {
+        PoolHeader* header = cache->free_blocks[size_class];
+        cache->free_blocks[size_class] = *next_free(header);
+        *next_free(header) = pool->free_blocks[size_class];
+        pool->free_blocks[size_class] = header;
+    }
+    cache->free_amt[size_class] -= amt;
+    pool->free_amt[size_class] += amt;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// returns: NULL if the block couldn't be allocated
+static PoolHeader* pool_alloc_large(Pool* pool, size_t size) {
+    if (size > SIZE_MAX - sizeof(PoolLargeBlock)) return NULL;
+    PoolLargeBlock* block = malloc(sizeof(PoolLargeBlock) + size);
+    if (block == NULL) return NULL;
+    block->reserved = sizeof(PoolLargeBlock) + size;
+    block->previous = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    block->next = pool->large_blocks;
+    if (block->next != NULL) block->next->previous = block;
+    pool->large_blocks = block;
+    pool_add_reserved(pool, block->reserved);
+    pthread_mutex_unlock(&pool->lock);
+
+    return &block->header;
+}
+
+static void pool_free_large(Pool* pool, PoolHeader* header) {
+    PoolLargeBlock* block = (PoolLargeBlock*)((char*)header - offsetof(PoolLargeBlock, header));
+
+    pthread_mutex_lock(&pool->lock);
+    if (block->previous != NULL) {
+        block->previous->next = block->next;
+    } else {
+        pool->large_blocks = block->next;
+    }
+    if (block->next != NULL) block->next->previous = block->previous;
+    pool->reserved -= block->reserved;
+    pthread_mutex_unlock(&pool->lock);
+
+    free(block);
+}
+
+static size_t pool_header_class_size(PoolHeader* header) {
+    return header->size_class == POOL_LARGE_CLASS ? header->size : pool_class_size(header->size_class);
+}
+
+static void pool_count_live(PoolStats* stats, int64_t bytes, int64_t class_bytes) {
+    stats->live_bytes += bytes;
+    stats->live_class_bytes += class_bytes;
+    if (stats->live_bytes > stats->peak_live_bytes) stats->peak_live_bytes = stats->live_bytes;
+    if (stats->live_class_bytes > stats->peak_class_bytes) stats->peak_class_bytes = stats->live_class_bytes;
+}
+
+static void* pool_alloc(void* context, size_t size) {
+    PoolCache* cache = context;
+
+    PoolHeader* header;
+    if (size > POOL_MAX_CLASS_SIZE) {
+        header = pool_alloc_large(cache->pool, size);
+        if (header == NULL) return NULL;
+        header->size_class = POOL_LARGE_CLASS;
+    } else {
+        size_t size_class = pool_class_of(size);
+        if (cache->free_blocks[size_class] == NULL && !pool_cache_refill(cache, size_class)) return NULL;
+
+        header = cache->free_blocks[size_class];
+        cache->free_blocks[size_class] = *next_free(header);
+        --cache->free_amt[size_class];
+    }
+    header->size = size;
+
+    ++cache->stats.allocations;
+    ++cache->stats.live_blocks;
+    pool_count_live(&cache->stats, size, pool_header_class_size(header));
+    return block_of(header);
+}
+
+static void pool_free_block(void* context, void* pointer) {
+    PoolCache* cache = context;
+    if (pointer == NULL) return;
+
+    PoolHeader* header = header_of(pointer);
+    ++cache->stats.frees;
+    --cache->stats.live_blocks;
+    pool_count_live(&cache->stats, -(int64_t)header->size, -(int64_t)pool_header_class_size(header));
+
+    if (header->size_class == POOL_LARGE_CLASS) {
+        pool_free_large(cache->pool, header);
+        return;
+    }
+
+    size_t size_class = header->size_class;
+    *next_free(header) = cache->free_blocks[size_class];
+    cache->free_blocks[size_class] = header;
+
+    // the blocks freed last stay in the cache, they are the most likely to be in the CPU cache
+    size_t batch = pool_batch_amt(size_class);
+    if (++cache->free_amt[size_class] >= 2 * batch) pool_cache_return(cache, size_class, batch);
+}
+
+static void* pool_realloc(void* context, void* pointer, size_t old_size, size_t new_size) {
+    PoolCache* cache = context;
+    (void)old_size;  // known from the header
+    if (pointer == NULL) return pool_alloc(context, new_size);
+
+    PoolHeader* header = header_of(pointer);
+    bool large = header->size_class == POOL_LARGE_CLASS;
+
+    // the block stays where it is if the size class doesn't change
+    if (!large && new_size <= POOL_MAX_CLASS_SIZE && pool_class_of(new_size) == header->size_class) {
+        ++cache->stats.reallocations;
+        pool_count_live(&cache->stats, (int64_t)new_size - (int64_t)header->size, 0);
+        header->size = new_size;
+        return pointer;
+    }
+
+    // the old block stays allocated if there is no memory for the new one
+    void* result = pool_alloc(context, new_size);
+    if (result == NULL) return NULL;
+    memcpy(result, pointer, header->size < new_size ? header->size : new_size);
+    pool_free_block(context, pointer);
+
+    // a move counts as neither an allocation nor a free
+    ++cache->stats.reallocations;
+    --cache->stats.allocations;
+    --cache->stats.frees;
+    return result;
+}
+
+Pool* pool_new() {
+    Pool* pool = calloc(1, sizeof(Pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+void pool_free(Pool* pool) {
+    while (pool->slabs != NULL) {
+        PoolSlab* next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+    while (pool->large_blocks != NULL) {
+        PoolLargeBlock* next = pool->large_blocks->next;
+        free(pool->large_blocks);
+        pool->large_blocks = next;
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+PoolCache* pool_cache_new(Pool* pool) {
+    PoolCache* cache = calloc(1, sizeof(PoolCache));
+    cache->allocator.alloc = pool_alloc;
+    cache->allocator.realloc = pool_realloc;
+    cache->allocator.free = pool_free_block;
+    cache->allocator.context = cache;
+    cache->pool = pool;
+    return cache;
+}
+
+void pool_cache_free(PoolCache* cache) {
+    for (size_t size_class = 0; size_class < POOL_CLASS_AMT; ++size_class) {
+        if (cache->free_amt[size_class] > 0) pool_cache_return(cache, size_class, cache->free_amt[size_class]);
+    }
+    free(cache);
+}
+
+Allocator* pool_cache_allocator(PoolCache* cache) {
+    return &cache->allocator;
+}
+
+size_t pool_block_size(void* pointer) {
+    return header_of(pointer)->size;
+}
+
+PoolStats pool_cache_stats(PoolCache* cache) {
+    PoolStats stats = cache->stats;
+
+    pthread_mutex_lock(&cache->pool->lock);
+    stats.reserved = cache->pool->reserved;
+    stats.peak_reserved = cache->pool->peak_reserved;
+    pthread_mutex_unlock(&cache->pool->lock);
+
+    return stats;
+}
@@ -0,0 +1,156 @@
+#ifndef _ALLOCATOR_H
+#define _ALLOCATOR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Where a library gets its memory from. Every function gets 'context' as its first argument
+typedef struct Allocator {
+    void* (*alloc)(void* context, size_t size);
+    // old_size: size the block was allocated with, so allocators without headers can copy it
+    void* (*realloc)(void* context, void* pointer, size_t old_size, size_t new_size);
+    void (*free)(void* context, void* pointer);
+    void* context;
+} Allocator;
+
+// malloc, realloc and free
+extern Allocator default_allocator;
+
+void* allocator_alloc(Allocator* allocator, size_t size);
+
+// like calloc, returns NULL if amt * size overflows
+void* allocator_calloc(Allocator* allocator, size_t amt, size_t size);
+
+void* allocator_realloc(Allocator* allocator, void* pointer, size_t old_size, size_t new_size);
+
+void allocator_free(Allocator* allocator, void* pointer);
+
+// ----- Arena -----
+
+// Hands out memory by bumping a pointer through chunks. Freeing does nothing, except for the
+// latest allocation, the memory comes back all at once through arena_release or arena_reset.
+// Chunks are kept for reuse, so an arena that is released over and over stops allocating.
+// Allocations larger than a chunk get a chunk of their own, which is freed again on release.
+// Allocating returns NULL once the system is out of memory.
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;  // bytes of 'data'
+    size_t used;
+    _Alignas(max_align_t) char data[];
+} ArenaChunk;
+
+typedef struct Arena {
+    Allocator allocator;  // context points to the arena itself
+    ArenaChunk* first;
+    ArenaChunk* current;
+    size_t chunk_size;
+    void* last;  // latest allocation, which can still be freed or grown in place
+} Arena;
+
+// a point to go back to with arena_release
+typedef struct ArenaMark {
+    ArenaChunk* chunk;
+    size_t used;
+} ArenaMark;
+
+// mallocs a new arena
+// chunk_size: bytes malloc'd at a time
+Arena* arena_new(size_t chunk_size);
+
+// returns: an allocator that allocates from the arena, valid as long as the arena
+Allocator* arena_allocator(Arena* arena);
+
+ArenaMark arena_mark(Arena* arena);
+
+// frees everything allocated after 'mark' was taken. Marks have to be released in reverse order
+void arena_release(Arena* arena, ArenaMark mark);
+
+// frees everything allocated so far
+void arena_reset(Arena* arena);
+
+void arena_free(Arena* arena);
+
+// ----- Pool -----
+
+// A general purpose allocator for blocks that are freed one by one in any order. Requests are
+// rounded up to one of a few dozen size classes, blocks of a class are cut from shared slabs
+// and kept on free lists for reuse. Requests larger than the largest class go to malloc.
+// Every block carries a header with its size, so it can be freed without knowing it.
+// Pointers aren't checked, freeing anything that isn't an allocated block of the pool is
+// undefined. Allocating returns NULL once the system is out of memory.
+// Threads don't allocate from the pool directly but through a PoolCache each: a cache keeps
+// a few free blocks of every class and only takes the pool's lock to exchange whole batches.
+// A block can be freed through any cache of the pool, slabs are returned to the system when
+// the pool is freed
+
+// requests up to this size are served from slabs
+#define POOL_MAX_CLASS_SIZE 32768
+#define POOL_CLASS_AMT 40
+
+// in front of every block
+typedef struct PoolHeader {
+    uint64_t size_class;
+    uint64_t size;  // bytes requested
+} PoolHeader;
+
+typedef struct PoolSlab PoolSlab;
+typedef struct PoolLargeBlock PoolLargeBlock;
+
+typedef struct Pool {
+    pthread_mutex_t lock;
+    PoolHeader* free_blocks[POOL_CLASS_AMT];  // linked through the first word behind the header
+    size_t free_amt[POOL_CLASS_AMT];
+    PoolSlab* slabs;
+    PoolLargeBlock* large_blocks;
+    size_t reserved;       // bytes taken from the system
+    size_t peak_reserved;
+} Pool;
+
+typedef struct PoolStats {
+    size_t allocations;
+    size_t reallocations;
+    size_t frees;
+    size_t live_blocks;
+    size_t live_bytes;       // bytes requested by the blocks that are allocated
+    size_t live_class_bytes;  // the same, rounded up to their size classes
+    size_t peak_live_bytes;
+    size_t peak_class_bytes;
+    size_t reserved;  // bytes taken from the system, for the whole pool
+    size_t peak_reserved;
+} PoolStats;
+
+// Owned by a single thread
+typedef struct PoolCache {
+    Allocator allocator;  // context points to the cache itself
+    Pool* pool;
+    PoolHeader* free_blocks[POOL_CLASS_AMT];
+    size_t free_amt[POOL_CLASS_AMT];
+    PoolStats stats;  // only counts blocks allocated and freed through this cache
+} PoolCache;
+
+// mallocs a new pool
+Pool* pool_new();
+
+// frees every slab and every large block, all caches have to be freed before
+void pool_free(Pool* pool);
+
+// mallocs a new cache for the calling thread
+PoolCache* pool_cache_new(Pool* pool);
+
+// hands the cached blocks back to the pool
+void pool_cache_free(PoolCache* cache);
+
+// returns: an allocator that allocates through the cache, valid as long as the cache
+Allocator* pool_cache_allocator(PoolCache* cache);
+
+// returns: bytes requested when 'pointer' was allocated or last reallocated
+size_t pool_block_size(void* pointer);
+
+// returns: counts for the blocks of the cache and the memory of the whole pool
+PoolStats pool_cache_stats(PoolCache* cache);
+
+#endif  // _ALLOCATOR_H
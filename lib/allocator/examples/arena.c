@@ -0,0 +1,85 @@
+// Allocates and frees in nested scopes, the way the interpreter does for function calls,
+// once with malloc and free and once from an arena that is released at the end of every scope.
+// The library is built without optimizations for the examples, so for meaningful numbers build
+// this on its own:
+//     gcc -O2 -std=c11 -I.. arena.c ../allocator.c -o arena
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "allocator.h"
+
+#define SCOPES 1000000
+#define DEPTH 16
+#define ALLOCATIONS_PER_SCOPE 4
+
+static double get_seconds() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int64_t run_default(size_t depth) {
+    int64_t* values[ALLOCATIONS_PER_SCOPE];
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < ALLOCATIONS_PER_SCOPE; ++i) {
+        values[i] = allocator_alloc(&default_allocator, sizeof(int64_t) * (i + 1));
+        values[i][0] = depth;
+    }
+    if (depth > 0) sum += run_default(depth - 1);
+    for (size_t i = 0; i < ALLOCATIONS_PER_SCOPE; ++i) {
+        sum += values[i][0];
+        allocator_free(&default_allocator, values[i]);
+    }
+
+    return sum;
+}
+
+static int64_t run_arena(Arena* arena, size_t depth) {
+    ArenaMark mark = arena_mark(arena);
+    int64_t* values[ALLOCATIONS_PER_SCOPE];
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < ALLOCATIONS_PER_SCOPE; ++i) {
+        values[i] = allocator_alloc(arena_allocator(arena), sizeof(int64_t) * (i + 1));
+        values[i][0] = depth;
+    }
+    if (depth > 0) sum += run_arena(arena, depth - 1);
+    for (size_t i = 0; i < ALLOCATIONS_PER_SCOPE; ++i) {
+        sum += values[i][0];
+    }
+
+    arena_release(arena, mark);
+    return sum;
+}
+
+int main() {
+    int64_t default_sum = 0;
+    double start = get_seconds();
+    for (size_t i = 0; i < SCOPES / DEPTH; ++i) {
+        default_sum += run_default(DEPTH - 1);
+    }
+    double default_time = get_seconds() - start;
+
+    // small chunks, so the deepest scopes need a second one
+    Arena* arena = arena_new(1024);
+    int64_t arena_sum = 0;
+    start = get_seconds();
+    for (size_t i = 0; i < SCOPES / DEPTH; ++i) {
+        arena_sum += run_arena(arena, DEPTH - 1);
+    }
+    double arena_time = get_seconds() - start;
+    arena_free(arena);
+
+    if (default_sum != arena_sum) {
+        fprintf(stderr, "Results differ\n");
+        return 1;
+    }
+
+    printf("malloc/free: %6.1f ns per scope\n", default_time * 1e9 / SCOPES);
+    printf("arena:       %6.1f ns per scope\n", arena_time * 1e9 / SCOPES);
+    return 0;
+}
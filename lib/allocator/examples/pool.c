@@ -0,0 +1,106 @@
+// Allocates and frees blocks of mixed sizes in random order on several threads, once with
+// malloc and free and once from a pool with a cache per thread, and prints the pool's stats.
+// The library is built without optimizations for the examples, so for meaningful numbers build
+// this on its own:
+//     gcc -O2 -std=c11 -pthread -I.. pool.c ../allocator.c -o pool
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "allocator.h"
+
+#define THREADS 4
+#define OPERATIONS 1000000
+#define LIVE_BLOCKS 1024
+#define MAX_SIZE 512
+
+typedef struct Work {
+    Pool* pool;  // NULL for malloc
+    uint64_t seed;
+    int64_t checksum;
+} Work;
+
+static double get_seconds() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void* run(void* argument) {
+    Work* work = argument;
+    PoolCache* cache = work->pool != NULL ? pool_cache_new(work->pool) : NULL;
+    Allocator* allocator = cache != NULL ? pool_cache_allocator(cache) : &default_allocator;
+
+    int64_t* blocks[LIVE_BLOCKS] = {0};
+    uint64_t state = work->seed;
+    for (size_t i = 0; i < OPERATIONS; ++i) {
+        size_t idx = next_random(&state) % LIVE_BLOCKS;
+        if (blocks[idx] != NULL) {
+            work->checksum += blocks[idx][0];
+            allocator_free(allocator, blocks[idx]);
+        }
+        blocks[idx] = allocator_alloc(allocator, 8 + next_random(&state) % MAX_SIZE);
+        blocks[idx][0] = i;
+    }
+    for (size_t i = 0; i < LIVE_BLOCKS; ++i) {
+        if (blocks[i] != NULL) work->checksum += blocks[i][0];
+        allocator_free(allocator, blocks[i]);
+    }
+
+    if (cache != NULL) {
+        PoolStats stats = pool_cache_stats(cache);
+        printf("cache %lu: %zu allocations, peak %zu bytes requested in %zu bytes of blocks\n",
+               (unsigned long)work->seed, stats.allocations, stats.peak_live_bytes, stats.peak_class_bytes);
+        pool_cache_free(cache);
+    }
+    return NULL;
+}
+
+static double run_threads(Pool* pool, int64_t* checksum) {
+    pthread_t threads[THREADS];
+    Work work[THREADS];
+
+    double start = get_seconds();
+    for (size_t i = 0; i < THREADS; ++i) {
+        work[i].pool = pool;
+        work[i].seed = i + 1;
+        work[i].checksum = 0;
+        pthread_create(&threads[i], NULL, run, &work[i]);
+    }
+    *checksum = 0;
+    for (size_t i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        *checksum += work[i].checksum;
+    }
+    return get_seconds() - start;
+}
+
+int main() {
+    int64_t malloc_checksum;
+    double malloc_time = run_threads(NULL, &malloc_checksum);
+
+    Pool* pool = pool_new();
+    int64_t pool_checksum;
+    double pool_time = run_threads(pool, &pool_checksum);
+    printf("pool: %zu bytes reserved at the peak\n", pool->peak_reserved);
+    pool_free(pool);
+
+    if (malloc_checksum != pool_checksum) {
+        fprintf(stderr, "Results differ\n");
+        return 1;
+    }
+
+    printf("malloc/free: %6.1f ns per operation\n", malloc_time * 1e9 / (THREADS * OPERATIONS));
+    printf("pool:        %6.1f ns per operation\n", pool_time * 1e9 / (THREADS * OPERATIONS));
+    return 0;
+}
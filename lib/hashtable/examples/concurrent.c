@@ -0,0 +1,171 @@
+// Stress test and throughput benchmark for ConcurrentHashTable.
+// Reader threads look up keys whose values never change while one writer keeps replacing
+// them with equal values, inserting and deleting other keys and growing the table. Every
+// lookup is checked, so a reader that sees a half-written or freed node fails the run.
+// The same lookups are timed on a HashTable behind a mutex for comparison.
+// The library is built without optimizations for the examples, so for meaningful numbers build
+// this on its own:
+//     gcc -O2 -std=c11 -pthread -I.. concurrent.c ../hashtable.c -o concurrent
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hashtable.h"
+
+#define STABLE_KEYS 4096
+#define LOOKUPS_PER_READER 1000000
+#define KEY_LENGTH 32
+#define MAX_READERS 8
+
+typedef struct Shared {
+    ConcurrentHashTable* concurrent;
+    HashTable* locked;
+    pthread_mutex_t lock;
+    char* keys;
+    atomic_bool done;
+    atomic_size_t errors;
+} Shared;
+
+static double get_seconds() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void* read_concurrent(void* arg) {
+    Shared* shared = arg;
+    HashEntry entry;
+    size_t idx = 0;
+
+    for (size_t i = 0; i < LOOKUPS_PER_READER; ++i) {
+        idx = (idx + 40503) % STABLE_KEYS;
+        char* key = shared->keys + idx * KEY_LENGTH;
+        if (!concurrent_hashtable_get(shared->concurrent, &entry, key) || (intptr_t)entry.value != (intptr_t)idx + 1) {
+            atomic_fetch_add(&shared->errors, 1);
+        }
+    }
+    return NULL;
+}
+
+static void* read_locked(void* arg) {
+    Shared* shared = arg;
+    HashEntry entry;
+    size_t idx = 0;
+
+    for (size_t i = 0; i < LOOKUPS_PER_READER; ++i) {
+        idx = (idx + 40503) % STABLE_KEYS;
+        pthread_mutex_lock(&shared->lock);
+        bool found = hashtable_get(shared->locked, &entry, shared->keys + idx * KEY_LENGTH);
+        pthread_mutex_unlock(&shared->lock);
+        if (!found || (intptr_t)entry.value != (intptr_t)idx + 1) {
+            atomic_fetch_add(&shared->errors, 1);
+        }
+    }
+    return NULL;
+}
+
+// keeps changing the table until the readers are done
+static void* write_concurrent(void* arg) {
+    Shared* shared = arg;
+    char key[KEY_LENGTH];
+    size_t round = 0;
+
+    while (!atomic_load(&shared->done)) {
+        size_t idx = (round * 7919) % STABLE_KEYS;
+        concurrent_hashtable_set(shared->concurrent, shared->keys + idx * KEY_LENGTH, (void*)((intptr_t)idx + 1));
+
+        snprintf(key, KEY_LENGTH, "churn_%zu", round % 512);
+        if (!concurrent_hashtable_delete(shared->concurrent, key)) {
+            concurrent_hashtable_set(shared->concurrent, key, NULL);
+        }
+
+        // a slowly growing set of keys makes the table grow now and then
+        if (round % 16 == 0) {
+            snprintf(key, KEY_LENGTH, "grown_%zu", round / 16);
+            concurrent_hashtable_set(shared->concurrent, key, NULL);
+        }
+
+        ++round;
+    }
+    return NULL;
+}
+
+static void* write_locked(void* arg) {
+    Shared* shared = arg;
+    size_t round = 0;
+
+    while (!atomic_load(&shared->done)) {
+        size_t idx = (round * 7919) % STABLE_KEYS;
+        pthread_mutex_lock(&shared->lock);
+        hashtable_set(shared->locked, shared->keys + idx * KEY_LENGTH, (void*)((intptr_t)idx + 1));
+        pthread_mutex_unlock(&shared->lock);
+        ++round;
+    }
+    return NULL;
+}
+
+// returns: million lookups per second over all readers
+static double run(Shared* shared, size_t reader_amt, bool concurrent) {
+    pthread_t readers[MAX_READERS];
+    pthread_t writer;
+
+    atomic_store(&shared->done, false);
+    pthread_create(&writer, NULL, concurrent ? write_concurrent : write_locked, shared);
+
+    double start = get_seconds();
+    for (size_t i = 0; i < reader_amt; ++i) {
+        pthread_create(&readers[i], NULL, concurrent ? read_concurrent : read_locked, shared);
+    }
+    for (size_t i = 0; i < reader_amt; ++i) {
+        pthread_join(readers[i], NULL);
+    }
+    double seconds = get_seconds() - start;
+
+    atomic_store(&shared->done, true);
+    pthread_join(writer, NULL);
+
+    return reader_amt * LOOKUPS_PER_READER / seconds / 1e6;
+}
+
+int main() {
+    Shared shared;
+    shared.keys = malloc(STABLE_KEYS * KEY_LENGTH);
+    for (size_t i = 0; i < STABLE_KEYS; ++i) {
+        snprintf(shared.keys + i * KEY_LENGTH, KEY_LENGTH, "key_%zu", i * 7919);
+    }
+    pthread_mutex_init(&shared.lock, NULL);
+    atomic_init(&shared.done, false);
+    atomic_init(&shared.errors, 0);
+
+    printf("%-8s %16s %16s\n", "readers", "lock-free M/s", "mutex M/s");
+    for (size_t reader_amt = 1; reader_amt <= MAX_READERS; reader_amt *= 2) {
+        shared.concurrent = concurrent_hashtable_new(ANY_T, STABLE_KEYS);
+        shared.locked = hashtable_new(ANY_T, STABLE_KEYS);
+        for (size_t i = 0; i < STABLE_KEYS; ++i) {
+            concurrent_hashtable_set(shared.concurrent, shared.keys + i * KEY_LENGTH, (void*)((intptr_t)i + 1));
+            hashtable_set(shared.locked, shared.keys + i * KEY_LENGTH, (void*)((intptr_t)i + 1));
+        }
+
+        double concurrent_rate = run(&shared, reader_amt, true);
+        double locked_rate = run(&shared, reader_amt, false);
+        printf("%-8zu %16.1f %16.1f\n", reader_amt, concurrent_rate, locked_rate);
+
+        concurrent_hashtable_free(shared.concurrent);
+        hashtable_free(shared.locked);
+    }
+
+    pthread_mutex_destroy(&shared.lock);
+    free(shared.keys);
+
+    size_t errors = atomic_load(&shared.errors);
+    if (errors != 0) {
+        fprintf(stderr, "%zu lookups returned a wrong result\n", errors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hashtable.h"
+
+int main() {
+    IntHashTable* squares = int_hashtable_new(4);
+
+    for (int64_t i = 0; i < 10; ++i) {
+        int_hashtable_set(squares, i, i * i);
+    }
+
+    int_hashtable_delete(squares, 3);
+
+    // values live in the table, so they can be updated through their address
+    int64_t* nine = int_hashtable_get_ptr(squares, 9);
+    *nine = -81;
+
+    for (int64_t i = 0; i < 10; ++i) {
+        int64_t value;
+        if (int_hashtable_get(squares, &value, i))
+            printf("%ld: %ld\n", i, value);
+        else
+            printf("%ld: -\n", i);
+    }
+
+    printf("%zu entries\n", int_hashtable_count(squares));
+
+    int_hashtable_free(squares);
+
+    return 0;
+}
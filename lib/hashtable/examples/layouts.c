@@ -0,0 +1,105 @@
+// Compares lookups in LAYOUT_LINEAR and LAYOUT_SWISS tables at different load factors, one at a
+// time and batched with hashtable_get_many.
+// The library is built without optimizations for the examples, so for meaningful numbers build
+// this on its own:
+//     gcc -O2 -std=c11 -I.. layouts.c ../hashtable.c -o layouts
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hashtable.h"
+
+#define TABLE_SIZE (1 << 16)
+#define LOOKUPS 2000000
+#define KEY_LENGTH 24
+#define BATCH_SIZE 64
+
+static double get_seconds() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static char* make_keys(char* prefix, size_t amt) {
+    char* keys = malloc(amt * KEY_LENGTH);
+    for (size_t i = 0; i < amt; ++i) {
+        snprintf(keys + i * KEY_LENGTH, KEY_LENGTH, "%s_%zu", prefix, i * 7919);
+    }
+    return keys;
+}
+
+// returns: nanoseconds per lookup
+static double time_lookups(HashTable* table, char* keys, size_t key_amt, size_t* found) {
+    HashEntry entry;
+    size_t idx = 0;
+    *found = 0;
+
+    double start = get_seconds();
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        // a large odd step visits the keys in an order unrelated to their insertion
+        idx = (idx + 40503) % key_amt;
+        *found += hashtable_get(table, &entry, keys + idx * KEY_LENGTH);
+    }
+    return (get_seconds() - start) * 1e9 / LOOKUPS;
+}
+
+// returns: nanoseconds per lookup
+static double time_batched_lookups(HashTable* table, char* keys, size_t key_amt, size_t* found) {
+    char* batch[BATCH_SIZE];
+    HashEntry entries[BATCH_SIZE];
+    size_t idx = 0;
+    *found = 0;
+
+    double start = get_seconds();
+    for (size_t i = 0; i < LOOKUPS; i += BATCH_SIZE) {
+        for (size_t b = 0; b < BATCH_SIZE; ++b) {
+            idx = (idx + 40503) % key_amt;
+            batch[b] = keys + idx * KEY_LENGTH;
+        }
+        *found += hashtable_get_many(table, entries, batch, BATCH_SIZE);
+    }
+    return (get_seconds() - start) * 1e9 / LOOKUPS;
+}
+
+int main() {
+    double loads[] = {0.25, 0.5, 0.625, 0.7};
+    size_t max_amt = TABLE_SIZE * 0.7;
+
+    char* keys = make_keys("key", max_amt);
+    char* misses = make_keys("miss", max_amt);
+
+    char* layout_names[] = {"linear", "swiss"};
+    enum HashTableLayout layouts[] = {LAYOUT_LINEAR, LAYOUT_SWISS};
+
+    printf("%-6s %-8s %10s %10s %10s\n", "load", "layout", "hit ns", "miss ns", "batch ns");
+    for (size_t l = 0; l < sizeof(loads) / sizeof(loads[0]); ++l) {
+        size_t amt = TABLE_SIZE * loads[l];
+
+        for (size_t i = 0; i < 2; ++i) {
+            // sized for the highest load, so every run probes a table of the same size
+            HashTable* table = hashtable_new_with_layout(ANY_T, max_amt, layouts[i]);
+            for (size_t k = 0; k < amt; ++k) {
+                hashtable_set(table, keys + k * KEY_LENGTH, NULL);
+            }
+
+            size_t hits, false_hits, batched_hits;
+            double hit_time = time_lookups(table, keys, amt, &hits);
+            double miss_time = time_lookups(table, misses, amt, &false_hits);
+            double batch_time = time_batched_lookups(table, keys, amt, &batched_hits);
+
+            if (table->size != TABLE_SIZE || hits != LOOKUPS || false_hits != 0 || batched_hits != LOOKUPS) {
+                fprintf(stderr, "Unexpected result for the %s layout\n", layout_names[i]);
+                return 1;
+            }
+
+            printf("%-6.3f %-8s %10.1f %10.1f %10.1f\n", loads[l], layout_names[i], hit_time, miss_time, batch_time);
+            hashtable_free(table);
+        }
+    }
+
+    free(keys);
+    free(misses);
+    return 0;
+}
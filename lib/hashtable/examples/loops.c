@@ -19,7 +19,8 @@ int main() {
 
     char* key;
     int64_t value;
-    while (hashtable_get_next_int(my_hashtable, &key, &value)) {
+    HashTableIterator iterator = hashtable_iterate(my_hashtable);
+    while (hashtable_iterator_next_int(&iterator, &key, &value)) {
         printf("%s: %ld\n", key, value);
     }
 
@@ -1,80 +1,269 @@
 #include "hashtable.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SSE2_GROUPS
+#endif
+
+// the table grows before more than MAX_LOAD_NUMERATOR / MAX_LOAD_DENOMINATOR of it is taken
+#define MAX_LOAD_NUMERATOR 3
+#define MAX_LOAD_DENOMINATOR 4
+#define MIN_SIZE 8
+
+// same for LAYOUT_SWISS, where tombstones count as taken
+#define SWISS_MAX_LOAD_NUMERATOR 7
+#define SWISS_MAX_LOAD_DENOMINATOR 8
+
+// Control bytes of LAYOUT_SWISS. Taken entries store the low 7 bits of their hash, so only
+// the free ones have the high bit set
+#define GROUP_SIZE 16
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+
+#define NOT_FOUND SIZE_MAX
+
 // http://www.cse.yorku.ca/~oz/hash.html
-static unsigned long hash_str(char* input) {
-    unsigned long hash = 5381;
+// followed by the murmur3 finalizer, entries are picked by the low bits only
+static uint64_t hash_str(char* input) {
+    uint64_t hash = 5381;
     int c;
 
     while ((c = *input++))
         hash = ((hash << 5) + hash) + c;  // hash * 33 + c
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
     return hash;
 }
 
-bool hashtable_set(HashTable* hashtable, char* key, void* value) {
-    unsigned long hash = hash_str(key);
-    unsigned int idx = hash % hashtable->size;
+static size_t size_for_count(enum HashTableLayout layout, size_t count) {
+    if (layout == LAYOUT_SWISS) {
+        // the repeated control bytes only cover the first group, so a group may not be larger than the table
+        size_t size = GROUP_SIZE;
+        while (count * SWISS_MAX_LOAD_DENOMINATOR > size * SWISS_MAX_LOAD_NUMERATOR) size *= 2;
+        return size;
+    }
 
-    char* existing_key = hashtable->entries[idx].key;
+    size_t size = MIN_SIZE;
+    while (count * MAX_LOAD_DENOMINATOR > size * MAX_LOAD_NUMERATOR) size *= 2;
+    return size;
+}
 
-    if (existing_key != NULL && strcmp(existing_key, key) == 0) {
-        hashtable->entries[idx].value = value;
-        return true;
+// ----- LAYOUT_SWISS -----
+
+// The control bytes of the first group are repeated after the last entry, so a group can be
+// loaded at any index without wrapping around
+
+// returns: bit i is set if the control byte at group[i] equals 'value'
+static uint32_t group_match(uint8_t* group, uint8_t value) {
+#ifdef HAVE_SSE2_GROUPS
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)value)));
+#else
+    uint32_t result = 0;
+    for (int i = 0; i < GROUP_SIZE; ++i) {
+        if (group[i] == value) result |= 1u << i;
+    }
+    return result;
+#endif
+}
+
+// returns: bit i is set if group[i] is empty or deleted
+static uint32_t group_match_free(uint8_t* group) {
+#ifdef HAVE_SSE2_GROUPS
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    uint32_t result = 0;
+    for (int i = 0; i < GROUP_SIZE; ++i) {
+        if (group[i] & 0x80) result |= 1u << i;
+    }
+    return result;
+#endif
+}
+
+static void swiss_set_ctrl(HashTable* hashtable, size_t idx, uint8_t value) {
+    hashtable->ctrl[idx] = value;
+    if (idx < GROUP_SIZE) hashtable->ctrl[hashtable->size + idx] = value;
+}
+
+// Groups are probed at triangular offsets, which visits every group start once the table
+// has been gone around. There is always an empty entry, so probing stops
+static size_t swiss_find(HashTable* hashtable, char* key, uint64_t hash) {
+    size_t mask = hashtable->size - 1;
+    uint8_t fragment = hash & 0x7F;
+    size_t pos = (hash >> 7) & mask;
+
+    for (size_t stride = GROUP_SIZE;; stride += GROUP_SIZE) {
+        uint8_t* group = hashtable->ctrl + pos;
+
+        uint32_t matches = group_match(group, fragment);
+        while (matches != 0) {
+            size_t idx = (pos + __builtin_ctz(matches)) & mask;
+            HashEntry* entry = &hashtable->entries[idx];
+            if (entry->hash == hash && strcmp(entry->key, key) == 0) return idx;
+            matches &= matches - 1;
+        }
+
+        // an empty entry ends every probe sequence that would have reached the key
+        if (group_match(group, CTRL_EMPTY) != 0) return NOT_FOUND;
+
+        pos = (pos + stride) & mask;
+    }
+}
+
+// returns: index of the first empty or deleted entry on the probe sequence of 'hash'
+static size_t swiss_find_free(HashTable* hashtable, uint64_t hash) {
+    size_t mask = hashtable->size - 1;
+    size_t pos = (hash >> 7) & mask;
+
+    for (size_t stride = GROUP_SIZE;; stride += GROUP_SIZE) {
+        uint32_t free_entries = group_match_free(hashtable->ctrl + pos);
+        if (free_entries != 0) return (pos + __builtin_ctz(free_entries)) & mask;
+
+        pos = (pos + stride) & mask;
+    }
+}
+
+// ----- LAYOUT_LINEAR -----
+
+// returns: index of the entry with this key, or of the free entry it would go into.
+// There is always a free entry, because the table never fills up completely
+static size_t find_index(HashTable* hashtable, char* key, uint64_t hash) {
+    size_t mask = hashtable->size - 1;
+    size_t idx = hash & mask;
+
+    while (hashtable->entries[idx].taken) {
+        HashEntry* entry = &hashtable->entries[idx];
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) return idx;
+        idx = (idx + 1) & mask;
     }
 
-    unsigned int checked = 0;
-    while (hashtable->entries[idx].taken == true) {
-        ++idx;
-        ++checked;
-        if (checked >= hashtable->size) {
-            return false;
+    return idx;
+}
+
+// ----- both layouts -----
+
+// returns: index of the entry with this key, or NOT_FOUND
+static size_t lookup(HashTable* hashtable, char* key, uint64_t hash) {
+    if (hashtable->layout == LAYOUT_SWISS) return swiss_find(hashtable, key, hash);
+
+    size_t idx = find_index(hashtable, key, hash);
+    return hashtable->entries[idx].taken ? idx : NOT_FOUND;
+}
+
+static void allocate(HashTable* hashtable, size_t size) {
+    hashtable->size = size;
+    hashtable->entries = allocator_calloc(hashtable->allocator, size, sizeof(HashEntry));  // initialise to 0, 'taken' is implicitly false
+    hashtable->ctrl = NULL;
+    hashtable->deleted = 0;
+
+    if (hashtable->layout == LAYOUT_SWISS) {
+        hashtable->ctrl = allocator_alloc(hashtable->allocator, size + GROUP_SIZE);
+        memset(hashtable->ctrl, CTRL_EMPTY, size + GROUP_SIZE);
+    }
+}
+
+static void resize(HashTable* hashtable, size_t new_size) {
+    HashEntry* old_entries = hashtable->entries;
+    uint8_t* old_ctrl = hashtable->ctrl;
+    size_t old_size = hashtable->size;
+
+    allocate(hashtable, new_size);
+
+    // keys are unique, so every entry goes into the first free spot of its probe sequence
+    size_t mask = new_size - 1;
+    for (size_t i = 0; i < old_size; ++i) {
+        if (!old_entries[i].taken) continue;
+
+        size_t idx;
+        if (hashtable->layout == LAYOUT_SWISS) {
+            idx = swiss_find_free(hashtable, old_entries[i].hash);
+            swiss_set_ctrl(hashtable, idx, old_entries[i].hash & 0x7F);
+        } else {
+            idx = old_entries[i].hash & mask;
+            while (hashtable->entries[idx].taken) {
+                idx = (idx + 1) & mask;
+            }
+        }
+        hashtable->entries[idx] = old_entries[i];
+    }
+
+    allocator_free(hashtable->allocator, old_entries);
+    if (old_ctrl != NULL) allocator_free(hashtable->allocator, old_ctrl);
+}
+
+// returns: index of a free entry for a new key with this hash, after growing if needed
+static size_t prepare_insert(HashTable* hashtable, char* key, uint64_t hash) {
+    if (hashtable->layout == LAYOUT_SWISS) {
+        if ((hashtable->count + hashtable->deleted + 1) * SWISS_MAX_LOAD_DENOMINATOR > hashtable->size * SWISS_MAX_LOAD_NUMERATOR) {
+            // mostly tombstones: rebuilding at the same size is enough
+            bool mostly_deleted = (hashtable->count + 1) * SWISS_MAX_LOAD_DENOMINATOR * 2 <= hashtable->size * SWISS_MAX_LOAD_NUMERATOR;
+            resize(hashtable, mostly_deleted ? hashtable->size : hashtable->size * 2);
+        }
+
+        size_t idx = swiss_find_free(hashtable, hash);
+        if (hashtable->ctrl[idx] == CTRL_DELETED) --hashtable->deleted;
+        swiss_set_ctrl(hashtable, idx, hash & 0x7F);
+        return idx;
+    }
+
+    if ((hashtable->count + 1) * MAX_LOAD_DENOMINATOR > hashtable->size * MAX_LOAD_NUMERATOR) {
+        resize(hashtable, hashtable->size * 2);
+    }
+    return find_index(hashtable, key, hash);
+}
+
+bool hashtable_set(HashTable* hashtable, char* key, void* value) {
+    uint64_t hash = hash_str(key);
+    size_t idx = lookup(hashtable, key, hash);
+
+    if (idx != NOT_FOUND) {
+        if (hashtable->free_entry_values && hashtable->entries[idx].value != value) {
+            allocator_free(hashtable->allocator, hashtable->entries[idx].value);
         }
+        hashtable->entries[idx].value = value;
+        return true;
     }
 
+    idx = prepare_insert(hashtable, key, hash);
+
     hashtable->entries[idx].taken = true;
-    hashtable->entries[idx].key = malloc(sizeof(char) * (strlen(key) + 1));
+    hashtable->entries[idx].hash = hash;
+    hashtable->entries[idx].key = allocator_alloc(hashtable->allocator, sizeof(char) * (strlen(key) + 1));
     strcpy(hashtable->entries[idx].key, key);
     hashtable->entries[idx].value = value;
+    ++hashtable->count;
     return true;
 }
 
 bool hashtable_set_int(HashTable* hashtable, char* key, int64_t value) {
     if (hashtable->type != INT_T) return false;
 
-    int64_t* new_value = malloc(sizeof(int64_t));
+    int64_t* new_value = allocator_alloc(hashtable->allocator, sizeof(int64_t));
     *new_value = value;
 
     return hashtable_set(hashtable, key, new_value);
 }
 
 bool hashtable_get(HashTable* hashtable, HashEntry* buffer, char* key) {
-    unsigned long hash = hash_str(key);
-    unsigned int idx = hash % hashtable->size;
+    size_t idx = lookup(hashtable, key, hash_str(key));
 
-    if (hashtable->entries[idx].taken == false) {
+    if (idx == NOT_FOUND) {
         return false;
     }
 
-    unsigned int checked = 0;
-    while (hashtable->entries[idx].key != NULL && strcmp(hashtable->entries[idx].key, key) != 0) {
-        ++idx;
-        ++checked;
-
-        if (checked >= hashtable->size) {
-            return false;
-        }
-
-        if (hashtable->entries[idx].taken == false) {
-            return false;
-        }
-    }
-
-    buffer->taken = hashtable->entries[idx].taken;
-    buffer->key = hashtable->entries[idx].key;
-    buffer->value = hashtable->entries[idx].value;
+    *buffer = hashtable->entries[idx];
     return true;
 }
 
@@ -86,41 +275,132 @@ bool hashtable_get_int(HashTable* hashtable, int64_t* buffer, char* key) {
     return true;
 }
 
-size_t hashtable_count(HashTable* hashtable) {
-    size_t count = 0;
+bool hashtable_delete(HashTable* hashtable, char* key) {
+    size_t idx = lookup(hashtable, key, hash_str(key));
+    if (idx == NOT_FOUND) return false;
+
+    if (hashtable->free_entry_values) {
+        allocator_free(hashtable->allocator, hashtable->entries[idx].value);
+    }
+    allocator_free(hashtable->allocator, hashtable->entries[idx].key);
+
+    if (hashtable->layout == LAYOUT_SWISS) {
+        // probe sequences skip groups without empty entries, so the entry has to stay in the way
+        memset(&hashtable->entries[idx], 0, sizeof(HashEntry));
+        swiss_set_ctrl(hashtable, idx, CTRL_DELETED);
+        ++hashtable->deleted;
+        --hashtable->count;
+        return true;
+    }
+
+    // Shift later entries of the same run back into the hole, so lookups never have to skip
+    // over deleted entries. An entry may move if the hole is between its home and where it is now
+    size_t mask = hashtable->size - 1;
+    size_t hole = idx;
+    size_t next = (hole + 1) & mask;
+    while (hashtable->entries[next].taken) {
+        size_t home = hashtable->entries[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            hashtable->entries[hole] = hashtable->entries[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    memset(&hashtable->entries[hole], 0, sizeof(HashEntry));
+    --hashtable->count;
+    return true;
+}
+
+void hashtable_clear(HashTable* hashtable) {
+    for (size_t i = 0; i < hashtable->size; ++i) {
+        if (!hashtable->entries[i].taken) continue;
+
+        if (hashtable->free_entry_values) {
+            allocator_free(hashtable->allocator, hashtable->entries[i].value);
+        }
+        allocator_free(hashtable->allocator, hashtable->entries[i].key);
+    }
 
-    for (unsigned int i = 0; i < hashtable->size; ++i) {
-        if (hashtable->entries[i].taken) ++count;
+    memset(hashtable->entries, 0, sizeof(HashEntry) * hashtable->size);
+    hashtable->count = 0;
+
+    if (hashtable->layout == LAYOUT_SWISS) {
+        memset(hashtable->ctrl, CTRL_EMPTY, hashtable->size + GROUP_SIZE);
+        hashtable->deleted = 0;
     }
+}
 
-    return count;
+void hashtable_reserve(HashTable* hashtable, size_t count) {
+    size_t size = size_for_count(hashtable->layout, count);
+    if (size > hashtable->size) resize(hashtable, size);
+}
+
+size_t hashtable_count(HashTable* hashtable) {
+    return hashtable->count;
 }
 
-bool hashtable_get_next(HashTable* hashtable, HashEntry* buffer) {
-    static unsigned int idx = -1;
+// keys hashed and prefetched ahead of probing by hashtable_get_many
+#define PREFETCH_BATCH 16
+
+size_t hashtable_get_many(HashTable* hashtable, HashEntry* buffers, char** keys, size_t count) {
+    size_t found = 0;
+    size_t mask = hashtable->size - 1;
+    uint64_t hashes[PREFETCH_BATCH];
+
+    for (size_t start = 0; start < count; start += PREFETCH_BATCH) {
+        size_t batch = count - start < PREFETCH_BATCH ? count - start : PREFETCH_BATCH;
+
+        for (size_t i = 0; i < batch; ++i) {
+            hashes[i] = hash_str(keys[start + i]);
+            if (hashtable->layout == LAYOUT_SWISS)
+                __builtin_prefetch(hashtable->ctrl + ((hashes[i] >> 7) & mask));
+            else
+                __builtin_prefetch(&hashtable->entries[hashes[i] & mask]);
+        }
 
-    ++idx;
+        for (size_t i = 0; i < batch; ++i) {
+            size_t idx = lookup(hashtable, keys[start + i], hashes[i]);
+            if (idx == NOT_FOUND) {
+                memset(&buffers[start + i], 0, sizeof(HashEntry));
+                continue;
+            }
 
-    while (!hashtable->entries[idx].taken) {
-        ++idx;
-        if (idx >= hashtable->size) {
-            idx = 0;
-            return false;
+            buffers[start + i] = hashtable->entries[idx];
+            ++found;
         }
     }
 
-    buffer->taken = hashtable->entries[idx].taken;
-    buffer->key = hashtable->entries[idx].key;
-    buffer->value = hashtable->entries[idx].value;
+    return found;
+}
+
+HashTableIterator hashtable_iterate(HashTable* hashtable) {
+    HashTableIterator iterator = {hashtable, 0};
+    return iterator;
+}
+
+bool hashtable_iterator_next(HashTableIterator* iterator, HashEntry* buffer) {
+    HashTable* hashtable = iterator->hashtable;
+
+    while (iterator->idx < hashtable->size && !hashtable->entries[iterator->idx].taken) {
+        ++iterator->idx;
+    }
+
+    if (iterator->idx >= hashtable->size) {
+        return false;
+    }
+
+    *buffer = hashtable->entries[iterator->idx];
+    ++iterator->idx;
 
     return true;
 }
 
-bool hashtable_get_next_int(HashTable* hashtable, char** buffer_key, int64_t* buffer_value) {
-    if (hashtable->type != INT_T) return false;
+bool hashtable_iterator_next_int(HashTableIterator* iterator, char** buffer_key, int64_t* buffer_value) {
+    if (iterator->hashtable->type != INT_T) return false;
 
     HashEntry buffer;
-    if (hashtable_get_next(hashtable, &buffer)) {
+    if (hashtable_iterator_next(iterator, &buffer)) {
         *buffer_key = buffer.key;
         *buffer_value = *(int64_t*)buffer.value;
         return true;
@@ -130,9 +410,19 @@ bool hashtable_get_next_int(HashTable* hashtable, char** buffer_key, int64_t* bu
 }
 
 HashTable* hashtable_new(enum HashTableType type, size_t size) {
-    HashTable* hashtable = malloc(sizeof(HashTable));
+    return hashtable_new_with_layout(type, size, LAYOUT_LINEAR);
+}
+
+HashTable* hashtable_new_with_layout(enum HashTableType type, size_t size, enum HashTableLayout layout) {
+    return hashtable_new_with_allocator(type, size, layout, &default_allocator);
+}
+
+HashTable* hashtable_new_with_allocator(enum HashTableType type, size_t size, enum HashTableLayout layout, Allocator* allocator) {
+    HashTable* hashtable = allocator_alloc(allocator, sizeof(HashTable));
+    hashtable->allocator = allocator;
     hashtable->type = type;
-    hashtable->size = size;
+    hashtable->layout = layout;
+    hashtable->count = 0;
     switch (type) {
         case ANY_T:
             hashtable->free_entry_values = false;
@@ -140,7 +430,7 @@ HashTable* hashtable_new(enum HashTableType type, size_t size) {
         case INT_T:
             hashtable->free_entry_values = true;
     }
-    hashtable->entries = calloc(size, sizeof(HashEntry));  // initialise to 0, 'taken' is implicitly false
+    allocate(hashtable, size_for_count(layout, size));
     return hashtable;
 }
 
@@ -149,12 +439,475 @@ void hashtable_force_free_values(HashTable* hashtable) {
 }
 
 void hashtable_free(HashTable* hashtable) {
-    for (size_t i = 1; i < hashtable->size; ++i) {
+    for (size_t i = 0; i < hashtable->size; ++i) {
+        if (!hashtable->entries[i].taken) continue;
+
         if (hashtable->free_entry_values) {
-            free(hashtable->entries[i].value);
+            allocator_free(hashtable->allocator, hashtable->entries[i].value);
         }
-        free(hashtable->entries[i].key);
+        allocator_free(hashtable->allocator, hashtable->entries[i].key);
+    }
+    if (hashtable->ctrl != NULL) allocator_free(hashtable->allocator, hashtable->ctrl);
+    allocator_free(hashtable->allocator, hashtable->entries);
+    allocator_free(hashtable->allocator, hashtable);
+}
+
+// ----- IntHashTable -----
+
+// the murmur3 finalizer, so keys that only differ in their high bits still spread out
+static uint64_t hash_int(int64_t key) {
+    uint64_t hash = (uint64_t)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// returns: index of the entry with this key, or of the free entry it would go into
+static size_t int_find_index(IntHashTable* hashtable, int64_t key) {
+    size_t mask = hashtable->size - 1;
+    size_t idx = hash_int(key) & mask;
+
+    while (hashtable->taken[idx] && hashtable->entries[idx].key != key) {
+        idx = (idx + 1) & mask;
     }
-    free(hashtable->entries);
+
+    return idx;
+}
+
+static void int_resize(IntHashTable* hashtable, size_t new_size) {
+    bool* old_taken = hashtable->taken;
+    IntHashEntry* old_entries = hashtable->entries;
+    size_t old_size = hashtable->size;
+
+    hashtable->size = new_size;
+    hashtable->taken = allocator_calloc(hashtable->allocator, new_size, sizeof(bool));
+    hashtable->entries = allocator_alloc(hashtable->allocator, sizeof(IntHashEntry) * new_size);
+
+    for (size_t i = 0; i < old_size; ++i) {
+        if (!old_taken[i]) continue;
+
+        size_t idx = int_find_index(hashtable, old_entries[i].key);
+        hashtable->taken[idx] = true;
+        hashtable->entries[idx] = old_entries[i];
+    }
+
+    allocator_free(hashtable->allocator, old_taken);
+    allocator_free(hashtable->allocator, old_entries);
+}
+
+IntHashTable* int_hashtable_new(size_t size) {
+    return int_hashtable_new_with_allocator(size, &default_allocator);
+}
+
+IntHashTable* int_hashtable_new_with_allocator(size_t size, Allocator* allocator) {
+    IntHashTable* hashtable = allocator_alloc(allocator, sizeof(IntHashTable));
+    hashtable->allocator = allocator;
+    hashtable->size = size_for_count(LAYOUT_LINEAR, size);
+    hashtable->count = 0;
+    hashtable->taken = allocator_calloc(allocator, hashtable->size, sizeof(bool));
+    hashtable->entries = allocator_alloc(allocator, sizeof(IntHashEntry) * hashtable->size);
+    return hashtable;
+}
+
+void int_hashtable_set(IntHashTable* hashtable, int64_t key, int64_t value) {
+    size_t idx = int_find_index(hashtable, key);
+
+    if (!hashtable->taken[idx]) {
+        if ((hashtable->count + 1) * MAX_LOAD_DENOMINATOR > hashtable->size * MAX_LOAD_NUMERATOR) {
+            int_resize(hashtable, hashtable->size * 2);
+            idx = int_find_index(hashtable, key);
+        }
+
+        hashtable->taken[idx] = true;
+        hashtable->entries[idx].key = key;
+        ++hashtable->count;
+    }
+
+    hashtable->entries[idx].value = value;
+}
+
+bool int_hashtable_get(IntHashTable* hashtable, int64_t* buffer, int64_t key) {
+    size_t idx = int_find_index(hashtable, key);
+    if (!hashtable->taken[idx]) return false;
+
+    *buffer = hashtable->entries[idx].value;
+    return true;
+}
+
+int64_t* int_hashtable_get_ptr(IntHashTable* hashtable, int64_t key) {
+    size_t idx = int_find_index(hashtable, key);
+    return hashtable->taken[idx] ? &hashtable->entries[idx].value : NULL;
+}
+
+bool int_hashtable_delete(IntHashTable* hashtable, int64_t key) {
+    size_t idx = int_find_index(hashtable, key);
+    if (!hashtable->taken[idx]) return false;
+
+    // same backward shift as hashtable_delete
+    size_t mask = hashtable->size - 1;
+    size_t hole = idx;
+    size_t next = (hole + 1) & mask;
+    while (hashtable->taken[next]) {
+        size_t home = hash_int(hashtable->entries[next].key) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            hashtable->entries[hole] = hashtable->entries[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    hashtable->taken[hole] = false;
+    --hashtable->count;
+    return true;
+}
+
+void int_hashtable_clear(IntHashTable* hashtable) {
+    memset(hashtable->taken, 0, sizeof(bool) * hashtable->size);
+    hashtable->count = 0;
+}
+
+void int_hashtable_reserve(IntHashTable* hashtable, size_t count) {
+    size_t size = size_for_count(LAYOUT_LINEAR, count);
+    if (size > hashtable->size) int_resize(hashtable, size);
+}
+
+size_t int_hashtable_count(IntHashTable* hashtable) {
+    return hashtable->count;
+}
+
+IntHashTableIterator int_hashtable_iterate(IntHashTable* hashtable) {
+    IntHashTableIterator iterator = {hashtable, 0};
+    return iterator;
+}
+
+bool int_hashtable_iterator_next(IntHashTableIterator* iterator, int64_t* buffer_key, int64_t* buffer_value) {
+    IntHashTable* hashtable = iterator->hashtable;
+
+    while (iterator->idx < hashtable->size && !hashtable->taken[iterator->idx]) {
+        ++iterator->idx;
+    }
+
+    if (iterator->idx >= hashtable->size) {
+        return false;
+    }
+
+    *buffer_key = hashtable->entries[iterator->idx].key;
+    *buffer_value = hashtable->entries[iterator->idx].value;
+    ++iterator->idx;
+
+    return true;
+}
+
+void int_hashtable_free(IntHashTable* hashtable) {
+    allocator_free(hashtable->allocator, hashtable->entries);
+    allocator_free(hashtable->allocator, hashtable->taken);
+    allocator_free(hashtable->allocator, hashtable);
+}
+
+// ----- ConcurrentHashTable -----
+
+// Linear probing like LAYOUT_LINEAR, but deleting leaves a tombstone: shifting entries back
+// would move them past readers that are probing concurrently.
+// Nodes are published with release stores and read with acquire loads, so a reader that
+// finds a node also sees its key and value
+
+// grace periods make writers wait, so retired pointers are freed in batches
+#define RETIRED_BEFORE_RECLAIM 64
+
+static ConcurrentNode tombstone;
+#define TOMBSTONE (&tombstone)
+
+// readers are spread over the slots in the order they first read, whatever the table
+static atomic_size_t next_reader_slot;
+static _Thread_local size_t reader_slot = SIZE_MAX;
+
+// Counts the reader in the current epoch. If the epoch moves on in between, the writer may
+// have missed the count, so the reader tries again in the new one
+// returns: the counter to decrement once the read is done
+static atomic_size_t* read_begin(ConcurrentHashTable* hashtable) {
+    if (reader_slot == SIZE_MAX) {
+        reader_slot = atomic_fetch_add(&next_reader_slot, 1) % CONCURRENT_READER_SLOTS;
+    }
+    ConcurrentReaderSlot* slot = &hashtable->readers[reader_slot];
+
+    for (;;) {
+        uint_fast64_t epoch = atomic_load(&hashtable->epoch);
+        atomic_size_t* active = &slot->active[epoch & 1];
+        atomic_fetch_add(active, 1);
+        if (atomic_load(&hashtable->epoch) == epoch) return active;
+        atomic_fetch_sub(active, 1);
+    }
+}
+
+static void read_end(atomic_size_t* active) {
+    atomic_fetch_sub_explicit(active, 1, memory_order_release);
+}
+
+// Starts a new epoch and waits for the reads of the previous one. Reads that start after
+// this can't reach anything that was unlinked before
+static void wait_for_readers(ConcurrentHashTable* hashtable) {
+    uint_fast64_t epoch = atomic_fetch_add(&hashtable->epoch, 1);
+
+    for (size_t i = 0; i < CONCURRENT_READER_SLOTS; ++i) {
+        while (atomic_load(&hashtable->readers[i].active[epoch & 1]) != 0) {
+            sched_yield();
+        }
+    }
+}
+
+static void reclaim(ConcurrentHashTable* hashtable) {
+    if (hashtable->retired == NULL) return;
+
+    wait_for_readers(hashtable);
+
+    while (hashtable->retired != NULL) {
+        RetiredPointer* next = hashtable->retired->next;
+        free(hashtable->retired->pointer);
+        free(hashtable->retired);
+        hashtable->retired = next;
+    }
+    hashtable->retired_amt = 0;
+}
+
+// frees 'pointer' once no reader can see it anymore
+static void retire(ConcurrentHashTable* hashtable, void* pointer) {
+    RetiredPointer* retired = malloc(sizeof(RetiredPointer));
+    retired->pointer = pointer;
+    retired->next = hashtable->retired;
+    hashtable->retired = retired;
+    ++hashtable->retired_amt;
+}
+
+// the node itself is retired by the caller, its key may have been taken over by another node
+static void retire_value(ConcurrentHashTable* hashtable, ConcurrentNode* node) {
+    if (hashtable->free_entry_values) retire(hashtable, node->value);
+}
+
+static ConcurrentEntries* concurrent_allocate(size_t size) {
+    ConcurrentEntries* entries = malloc(sizeof(ConcurrentEntries) + sizeof(_Atomic(ConcurrentNode*)) * size);
+    entries->size = size;
+    for (size_t i = 0; i < size; ++i) {
+        atomic_init(&entries->nodes[i], NULL);
+    }
+    return entries;
+}
+
+// returns: the node with this key, or NULL
+static ConcurrentNode* concurrent_find(ConcurrentEntries* entries, char* key, uint64_t hash) {
+    size_t mask = entries->size - 1;
+
+    // there is always an empty entry, even in arrays that have been replaced
+    for (size_t idx = hash & mask;; idx = (idx + 1) & mask) {
+        ConcurrentNode* node = atomic_load_explicit(&entries->nodes[idx], memory_order_acquire);
+        if (node == NULL) return NULL;
+        if (node != TOMBSTONE && node->hash == hash && strcmp(node->key, key) == 0) return node;
+    }
+}
+
+// for writers, holding the lock
+// free_idx: receives the first tombstone or empty entry on the way, where a new key would go
+// returns: index of the entry with this key, or NOT_FOUND
+static size_t concurrent_find_index(ConcurrentEntries* entries, char* key, uint64_t hash, size_t* free_idx) {
+    size_t mask = entries->size - 1;
+    *free_idx = NOT_FOUND;
+
+    for (size_t idx = hash & mask;; idx = (idx + 1) & mask) {
+        ConcurrentNode* node = atomic_load_explicit(&entries->nodes[idx], memory_order_relaxed);
+        if (node == NULL || node == TOMBSTONE) {
+            if (*free_idx == NOT_FOUND) *free_idx = idx;
+            if (node == NULL) return NOT_FOUND;
+        } else if (node->hash == hash && strcmp(node->key, key) == 0) {
+            return idx;
+        }
+    }
+}
+
+// Copies the nodes into a new array and publishes it. Readers still probing the old array
+// find the same nodes there, the array itself is retired
+static void concurrent_resize(ConcurrentHashTable* hashtable, size_t new_size) {
+    ConcurrentEntries* old_entries = atomic_load_explicit(&hashtable->entries, memory_order_relaxed);
+    ConcurrentEntries* new_entries = concurrent_allocate(new_size);
+
+    size_t mask = new_size - 1;
+    for (size_t i = 0; i < old_entries->size; ++i) {
+        ConcurrentNode* node = atomic_load_explicit(&old_entries->nodes[i], memory_order_relaxed);
+        if (node == NULL || node == TOMBSTONE) continue;
+
+        size_t idx = node->hash & mask;
+        while (atomic_load_explicit(&new_entries->nodes[idx], memory_order_relaxed) != NULL) {
+            idx = (idx + 1) & mask;
+        }
+        atomic_store_explicit(&new_entries->nodes[idx], node, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&hashtable->entries, new_entries, memory_order_release);
+    hashtable->used = atomic_load_explicit(&hashtable->count, memory_order_relaxed);
+
+    retire(hashtable, old_entries);
+}
+
+ConcurrentHashTable* concurrent_hashtable_new(enum HashTableType type, size_t size) {
+    // aligned, so every reader slot gets a cache line of its own
+    ConcurrentHashTable* hashtable = aligned_alloc(_Alignof(ConcurrentHashTable), sizeof(ConcurrentHashTable));
+
+    for (size_t i = 0; i < CONCURRENT_READER_SLOTS; ++i) {
+        atomic_init(&hashtable->readers[i].active[0], 0);
+        atomic_init(&hashtable->readers[i].active[1], 0);
+    }
+    atomic_init(&hashtable->entries, concurrent_allocate(size_for_count(LAYOUT_LINEAR, size)));
+    atomic_init(&hashtable->epoch, 0);
+    atomic_init(&hashtable->count, 0);
+    hashtable->type = type;
+    hashtable->free_entry_values = type == INT_T;
+
+    pthread_mutex_init(&hashtable->write_lock, NULL);
+    hashtable->used = 0;
+    hashtable->retired = NULL;
+    hashtable->retired_amt = 0;
+    return hashtable;
+}
+
+bool concurrent_hashtable_set(ConcurrentHashTable* hashtable, char* key, void* value) {
+    uint64_t hash = hash_str(key);
+
+    pthread_mutex_lock(&hashtable->write_lock);
+
+    ConcurrentEntries* entries = atomic_load_explicit(&hashtable->entries, memory_order_relaxed);
+    size_t free_idx;
+    size_t idx = concurrent_find_index(entries, key, hash, &free_idx);
+
+    ConcurrentNode* node = malloc(sizeof(ConcurrentNode));
+    node->hash = hash;
+    node->value = value;
+
+    if (idx != NOT_FOUND) {
+        // the replacement takes over the key, the old node keeps pointing to it until it is freed
+        ConcurrentNode* old_node = atomic_load_explicit(&entries->nodes[idx], memory_order_relaxed);
+        node->key = old_node->key;
+        atomic_store_explicit(&entries->nodes[idx], node, memory_order_release);
+
+        if (old_node->value != value) retire_value(hashtable, old_node);
+        retire(hashtable, old_node);
+    } else {
+        node->key = malloc(sizeof(char) * (strlen(key) + 1));
+        strcpy(node->key, key);
+
+        // tombstones count as used, they lengthen probes just the same
+        bool reuses_tombstone = atomic_load_explicit(&entries->nodes[free_idx], memory_order_relaxed) == TOMBSTONE;
+        if (!reuses_tombstone && (hashtable->used + 1) * MAX_LOAD_DENOMINATOR > entries->size * MAX_LOAD_NUMERATOR) {
+            size_t count = atomic_load_explicit(&hashtable->count, memory_order_relaxed);
+            // mostly tombstones: rebuilding at the same size is enough
+            bool mostly_deleted = (count + 1) * MAX_LOAD_DENOMINATOR * 2 <= entries->size * MAX_LOAD_NUMERATOR;
+            concurrent_resize(hashtable, mostly_deleted ? entries->size : entries->size * 2);
+
+            entries = atomic_load_explicit(&hashtable->entries, memory_order_relaxed);
+            concurrent_find_index(entries, key, hash, &free_idx);
+            reuses_tombstone = false;
+        }
+
+        atomic_store_explicit(&entries->nodes[free_idx], node, memory_order_release);
+        if (!reuses_tombstone) ++hashtable->used;
+        atomic_fetch_add_explicit(&hashtable->count, 1, memory_order_relaxed);
+    }
+
+    if (hashtable->retired_amt >= RETIRED_BEFORE_RECLAIM) reclaim(hashtable);
+
+    pthread_mutex_unlock(&hashtable->write_lock);
+    return true;
+}
+
+bool concurrent_hashtable_set_int(ConcurrentHashTable* hashtable, char* key, int64_t value) {
+    if (hashtable->type != INT_T) return false;
+
+    int64_t* new_value = malloc(sizeof(int64_t));
+    *new_value = value;
+
+    return concurrent_hashtable_set(hashtable, key, new_value);
+}
+
+bool concurrent_hashtable_get(ConcurrentHashTable* hashtable, HashEntry* buffer, char* key) {
+    uint64_t hash = hash_str(key);
+
+    atomic_size_t* active = read_begin(hashtable);
+    ConcurrentEntries* entries = atomic_load_explicit(&hashtable->entries, memory_order_acquire);
+    ConcurrentNode* node = concurrent_find(entries, key, hash);
+    if (node != NULL) {
+        buffer->taken = true;
+        buffer->hash = node->hash;
+        buffer->key = node->key;
+        buffer->value = node->value;
+    }
+    read_end(active);
+
+    return node != NULL;
+}
+
+bool concurrent_hashtable_get_int(ConcurrentHashTable* hashtable, int64_t* buffer, char* key) {
+    if (hashtable->type != INT_T) return false;
+
+    uint64_t hash = hash_str(key);
+
+    // the value is read before the read ends, a concurrent set may free it right after
+    atomic_size_t* active = read_begin(hashtable);
+    ConcurrentEntries* entries = atomic_load_explicit(&hashtable->entries, memory_order_acquire);
+    ConcurrentNode* node = concurrent_find(entries, key, hash);
+    if (node != NULL) *buffer = *(int64_t*)node->value;
+    read_end(active);
+
+    return node != NULL;
+}
+
+bool concurrent_hashtable_delete(ConcurrentHashTable* hashtable, char* key) {
+    uint64_t hash = hash_str(key);
+
+    pthread_mutex_lock(&hashtable->write_lock);
+
+    ConcurrentEntries* entries = atomic_load_explicit(&hashtable->entries, memory_order_relaxed);
+    size_t free_idx;
+    size_t idx = concurrent_find_index(entries, key, hash, &free_idx);
+
+    if (idx != NOT_FOUND) {
+        ConcurrentNode* node = atomic_load_explicit(&entries->nodes[idx], memory_order_relaxed);
+        atomic_store_explicit(&entries->nodes[idx], TOMBSTONE, memory_order_release);
+        atomic_fetch_sub_explicit(&hashtable->count, 1, memory_order_relaxed);
+
+        retire_value(hashtable, node);
+        retire(hashtable, node->key);
+        retire(hashtable, node);
+        if (hashtable->retired_amt >= RETIRED_BEFORE_RECLAIM) reclaim(hashtable);
+    }
+
+    pthread_mutex_unlock(&hashtable->write_lock);
+    return idx != NOT_FOUND;
+}
+
+size_t concurrent_hashtable_count(ConcurrentHashTable* hashtable) {
+    return atomic_load_explicit(&hashtable->count, memory_order_relaxed);
+}
+
+void concurrent_hashtable_force_free_values(ConcurrentHashTable* hashtable) {
+    hashtable->free_entry_values = true;
+}
+
+void concurrent_hashtable_free(ConcurrentHashTable* hashtable) {
+    reclaim(hashtable);
+
+    ConcurrentEntries* entries = atomic_load_explicit(&hashtable->entries, memory_order_relaxed);
+    for (size_t i = 0; i < entries->size; ++i) {
+        ConcurrentNode* node = atomic_load_explicit(&entries->nodes[i], memory_order_relaxed);
+        if (node == NULL || node == TOMBSTONE) continue;
+
+        if (hashtable->free_entry_values) {
+            free(node->value);
+        }
+        free(node->key);
+        free(node);
+    }
+    free(entries);
+
+    pthread_mutex_destroy(&hashtable->write_lock);
     free(hashtable);
 }
@@ -1,26 +1,48 @@
 #ifndef _HASHTABLE_H
 #define _HASHTABLE_H
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "allocator/allocator.h"
+
 enum HashTableType {
     INT_T,
     ANY_T
 };
 
+// How entries are found. Both store their entries the same way, so everything but lookups,
+// inserts and deletes behaves the same
+enum HashTableLayout {
+    // linear probing over the entries. Doubles once 3/4 full, deleting shifts the following
+    // entries back instead of leaving tombstones
+    LAYOUT_LINEAR,
+    // a separate array of control bytes holding 7 bits of every hash, probed 16 at a time, so
+    // most lookups only touch the key they are looking for. Doubles once 7/8 full, counting
+    // the tombstones left by deleting
+    LAYOUT_SWISS,
+};
+
 typedef struct HashEntry {
     bool taken;
+    uint64_t hash;  // cached, so probing and growing don't rehash the key
     char* key;
     void* value;
 } HashEntry;
 
 typedef struct HashTable {
+    Allocator* allocator;  // for the table, its keys and the values it frees
     enum HashTableType type;
-    size_t size;
+    enum HashTableLayout layout;
+    size_t size;     // amount of entries, always a power of two
+    size_t count;    // amount of entries that are taken
+    size_t deleted;  // amount of tombstones, only used by LAYOUT_SWISS
     bool free_entry_values;
     HashEntry* entries;
+    uint8_t* ctrl;  // only used by LAYOUT_SWISS
 } HashTable;
 
 // specific set method for int
@@ -30,6 +52,7 @@ bool hashtable_set_int(HashTable* hashtable, char* key, int64_t value);
 
 // general set method
 // type-unsafe
+// replaces the value of an existing key, freeing the old one if values are freed by the table
 // returns: success or not
 bool hashtable_set(HashTable* hashtable, char* key, void* value);
 
@@ -43,22 +66,56 @@ bool hashtable_get_int(HashTable* hashtable, int64_t* buffer, char* key);
 // returns: success or not
 bool hashtable_get(HashTable* hashtable, HashEntry* buffer, char* key);
 
+// removes a key, freeing its value if values are freed by the table
+// returns: false if the key wasn't there
+bool hashtable_delete(HashTable* hashtable, char* key);
+
+// removes every key, keeping the allocated entries
+void hashtable_clear(HashTable* hashtable);
+
+// grows the table so that 'count' elements fit without growing again
+void hashtable_reserve(HashTable* hashtable, size_t count);
+
 // gets the amount of elements in a hashtable
 size_t hashtable_count(HashTable* hashtable);
 
+// looks up 'count' keys at once. All keys are hashed and their first entries prefetched
+// before probing, so the cache misses of the lookups overlap
+// buffers: receives an entry for every key, with 'taken' set to false if the key wasn't there
+// returns: amount of keys that were found
+size_t hashtable_get_many(HashTable* hashtable, HashEntry* buffers, char** keys, size_t count);
+
+// Walks over the entries of a table. Any amount of iterators can be in use at the same time.
+// The table must not be changed while iterating
+typedef struct HashTableIterator {
+    HashTable* hashtable;
+    size_t idx;
+} HashTableIterator;
+
+// returns: an iterator positioned before the first entry
+HashTableIterator hashtable_iterate(HashTable* hashtable);
+
 // gets the next entry in the hashtable
 // type-unsafe
 // returns: True if an item has been written to buffer. False if the latest item was the last one
-bool hashtable_get_next(HashTable* hashtable, HashEntry* buffer);
+bool hashtable_iterator_next(HashTableIterator* iterator, HashEntry* buffer);
 
 // gets the next int in the hashtable
 // type-safe
 // returns: True if an item has been written to buffer. False if the latest item was the last one
-bool hashtable_get_next_int(HashTable* hashtable, char** buffer_key, int64_t* buffer_value);
+bool hashtable_iterator_next_int(HashTableIterator* iterator, char** buffer_key, int64_t* buffer_value);
 
-// mallocs a new hashtable with initial values
+// mallocs a new hashtable with initial values, using LAYOUT_LINEAR
+// size: amount of elements that fit before the table has to grow
 HashTable* hashtable_new(enum HashTableType type, size_t size);
 
+// like hashtable_new, with a choice of layout
+HashTable* hashtable_new_with_layout(enum HashTableType type, size_t size, enum HashTableLayout layout);
+
+// like hashtable_new_with_layout, taking all memory from 'allocator'. Values freed by the table
+// have to come from the same allocator
+HashTable* hashtable_new_with_allocator(enum HashTableType type, size_t size, enum HashTableLayout layout, Allocator* allocator);
+
 // override default setting
 // frees the void* value from all HashEntries in the HashTable on
 // a call to hashtable_free
@@ -67,4 +124,143 @@ void hashtable_force_free_values(HashTable* hashtable);
 // frees the hashtable
 void hashtable_free(HashTable* hashtable);
 
+// ----- IntHashTable -----
+
+typedef struct IntHashEntry {
+    int64_t key;
+    int64_t value;
+} IntHashEntry;
+
+// Keyed by int64_t, with the values stored in the entries, so nothing is malloc'd per element.
+// Pointers can be used as keys and values by casting them through intptr_t.
+// Uses linear probing like LAYOUT_LINEAR: doubles once 3/4 full, deleting shifts entries back
+typedef struct IntHashTable {
+    Allocator* allocator;
+    size_t size;   // amount of entries, always a power of two
+    size_t count;  // amount of entries that are taken
+    bool* taken;
+    IntHashEntry* entries;
+} IntHashTable;
+
+// mallocs a new table
+// size: amount of elements that fit before the table has to grow
+IntHashTable* int_hashtable_new(size_t size);
+
+// like int_hashtable_new, taking all memory from 'allocator'
+IntHashTable* int_hashtable_new_with_allocator(size_t size, Allocator* allocator);
+
+// adds the key or replaces its value
+void int_hashtable_set(IntHashTable* hashtable, int64_t key, int64_t value);
+
+// returns: success or not
+bool int_hashtable_get(IntHashTable* hashtable, int64_t* buffer, int64_t key);
+
+// returns: address of the value stored for the key, or NULL. Only valid until the next set
+int64_t* int_hashtable_get_ptr(IntHashTable* hashtable, int64_t key);
+
+// returns: false if the key wasn't there
+bool int_hashtable_delete(IntHashTable* hashtable, int64_t key);
+
+// removes every key, keeping the allocated entries
+void int_hashtable_clear(IntHashTable* hashtable);
+
+// grows the table so that 'count' elements fit without growing again
+void int_hashtable_reserve(IntHashTable* hashtable, size_t count);
+
+size_t int_hashtable_count(IntHashTable* hashtable);
+
+typedef struct IntHashTableIterator {
+    IntHashTable* hashtable;
+    size_t idx;
+} IntHashTableIterator;
+
+// returns: an iterator positioned before the first entry. The table must not be changed while iterating
+IntHashTableIterator int_hashtable_iterate(IntHashTable* hashtable);
+
+// returns: True if an item has been written to the buffers. False if the latest item was the last one
+bool int_hashtable_iterator_next(IntHashTableIterator* iterator, int64_t* buffer_key, int64_t* buffer_value);
+
+void int_hashtable_free(IntHashTable* hashtable);
+
+// ----- ConcurrentHashTable -----
+
+// For tables that are shared between threads and read far more often than written.
+// Readers never take a lock and never wait for writers: every key is kept in a node that
+// doesn't change once it is in the table, so a reader sees either the old or the new node.
+// Writers are serialized by a mutex. Growing builds a new entry array next to the old one,
+// so readers that are still probing the old array finish there undisturbed.
+// Replaced and deleted nodes, and old entry arrays, are freed once every reader that could
+// still see them has finished (RCU-style grace periods). Only writers wait for those.
+// Keys and values returned by a get stay valid until the key is replaced or deleted.
+
+// readers are spread over this many counters, so they rarely write to the same cache line
+#define CONCURRENT_READER_SLOTS 64
+
+typedef struct ConcurrentNode {
+    uint64_t hash;
+    char* key;
+    void* value;
+} ConcurrentNode;
+
+typedef struct ConcurrentEntries {
+    size_t size;  // always a power of two
+    _Atomic(ConcurrentNode*) nodes[];
+} ConcurrentEntries;
+
+typedef struct ConcurrentReaderSlot {
+    // amount of readers in a read that started in an even or an odd epoch
+    _Alignas(64) atomic_size_t active[2];
+} ConcurrentReaderSlot;
+
+// waiting to be freed once no reader can see it anymore
+typedef struct RetiredPointer {
+    void* pointer;
+    struct RetiredPointer* next;
+} RetiredPointer;
+
+typedef struct ConcurrentHashTable {
+    ConcurrentReaderSlot readers[CONCURRENT_READER_SLOTS];
+    _Atomic(ConcurrentEntries*) entries;
+    atomic_uint_fast64_t epoch;
+    atomic_size_t count;
+    enum HashTableType type;
+    bool free_entry_values;
+
+    // only used while holding the lock
+    pthread_mutex_t write_lock;
+    size_t used;  // taken and deleted entries of the current array
+    RetiredPointer* retired;
+    size_t retired_amt;
+} ConcurrentHashTable;
+
+// mallocs a new table
+// size: amount of elements that fit before the table has to grow
+ConcurrentHashTable* concurrent_hashtable_new(enum HashTableType type, size_t size);
+
+// adds the key or replaces its value. Safe to call from any thread
+// returns: success or not
+bool concurrent_hashtable_set(ConcurrentHashTable* hashtable, char* key, void* value);
+
+// returns: success or not
+bool concurrent_hashtable_set_int(ConcurrentHashTable* hashtable, char* key, int64_t value);
+
+// lock-free, safe to call from any thread
+// returns: success or not
+bool concurrent_hashtable_get(ConcurrentHashTable* hashtable, HashEntry* buffer, char* key);
+
+// lock-free, safe to call from any thread
+// returns: success or not
+bool concurrent_hashtable_get_int(ConcurrentHashTable* hashtable, int64_t* buffer, char* key);
+
+// returns: false if the key wasn't there
+bool concurrent_hashtable_delete(ConcurrentHashTable* hashtable, char* key);
+
+size_t concurrent_hashtable_count(ConcurrentHashTable* hashtable);
+
+// frees the void* values of all entries when they are removed or the table is freed
+void concurrent_hashtable_force_free_values(ConcurrentHashTable* hashtable);
+
+// frees the table. No other thread may be using it anymore
+void concurrent_hashtable_free(ConcurrentHashTable* hashtable);
+
 #endif  // _HASHTABLE_H
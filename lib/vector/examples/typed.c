@@ -0,0 +1,40 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "vector.h"
+
+typedef struct Point {
+    int32_t x;
+    int32_t y;
+} Point;
+
+int main() {
+    // elements are stored in the vector itself, the first few don't need any allocation
+    Vector points;
+    vector_init(&points, sizeof(Point));
+
+    for (int32_t i = 0; i < 10; ++i) {
+        Point point = {i, i * i};
+        vector_append(&points, &point);
+        printf("%zu points, stored %s\n", vector_size(&points), points.heap == NULL ? "inline" : "on the heap");
+    }
+
+    Point more[] = {{-1, -1}, {-2, -4}, {-3, -9}};
+    vector_push_many(&points, more, sizeof(more) / sizeof(more[0]));
+
+    Point last;
+    vector_pop(&points, &last);
+    printf("popped (%d, %d)\n", last.x, last.y);
+
+    for (size_t i = 0; i < vector_size(&points); ++i) {
+        Point* point = vector_at(&points, i);
+        printf("(%d, %d)\n", point->x, point->y);
+    }
+
+    vector_shrink_to_fit(&points);
+    printf("capacity after shrinking: %zu\n", points.capacity);
+
+    vector_deinit(&points);
+
+    return 0;
+}
@@ -2,59 +2,145 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #define PTR_SIZE sizeof(void*)
 
-Vector* vector_new(size_t initial_size) {
-    Vector* output = (Vector*)malloc(sizeof(Vector));
-    output->arr = (void**)malloc(sizeof(void*) * initial_size);
-    output->length = 0;
-    output->capacity = initial_size;
+static size_t inline_capacity(size_t elem_size) {
+    return VECTOR_INLINE_SIZE / elem_size;
+}
+
+// the elements live inline until they are moved to the heap, so a vector can be copied
+// around by value as long as only one of the copies is used afterwards
+static char* elements(Vector* v) {
+    return v->heap != NULL ? v->heap : v->inline_storage;
+}
+
+// moves the elements into a buffer of exactly 'capacity' elements, or back inline
+static void set_capacity(Vector* v, size_t capacity) {
+    if (capacity <= inline_capacity(v->elem_size)) {
+        if (v->heap != NULL) {
+            memcpy(v->inline_storage, v->heap, v->length * v->elem_size);
+            allocator_free(v->allocator, v->heap);
+            v->heap = NULL;
+        }
+        v->capacity = inline_capacity(v->elem_size);
+        return;
+    }
+
+    if (v->heap != NULL) {
+        v->heap = allocator_realloc(v->allocator, v->heap, v->capacity * v->elem_size, capacity * v->elem_size);
+    } else {
+        v->heap = allocator_alloc(v->allocator, capacity * v->elem_size);
+        memcpy(v->heap, v->inline_storage, v->length * v->elem_size);
+    }
+    v->capacity = capacity;
+}
+
+// doubles the capacity until 'count' elements fit
+static void grow_to(Vector* v, size_t count) {
+    if (count <= v->capacity) return;
+
+    size_t capacity = v->capacity > 0 ? v->capacity : 1;
+    while (capacity < count) capacity *= 2;
+    set_capacity(v, capacity);
+}
+
+void vector_init(Vector* v, size_t elem_size) {
+    vector_init_with_allocator(v, elem_size, &default_allocator);
+}
+
+void vector_init_with_allocator(Vector* v, size_t elem_size, Allocator* allocator) {
+    v->allocator = allocator;
+    v->heap = NULL;
+    v->elem_size = elem_size;
+    v->length = 0;
+    v->capacity = inline_capacity(elem_size);
+}
+
+void vector_deinit(Vector* v) {
+    if (v->heap != NULL) allocator_free(v->allocator, v->heap);
+    v->heap = NULL;
+    v->length = 0;
+    v->capacity = inline_capacity(v->elem_size);
+}
+
+Vector* vector_new_typed(size_t elem_size, size_t initial_size) {
+    return vector_new_with_allocator(elem_size, initial_size, &default_allocator);
+}
+
+Vector* vector_new_with_allocator(size_t elem_size, size_t initial_size, Allocator* allocator) {
+    Vector* output = (Vector*)allocator_alloc(allocator, sizeof(Vector));
+    vector_init_with_allocator(output, elem_size, allocator);
+    vector_reserve(output, initial_size);
 
     return output;
 }
 
+Vector* vector_new(size_t initial_size) {
+    return vector_new_typed(PTR_SIZE, initial_size);
+}
+
 void vector_free(Vector* v) {
     for (size_t i = 0; i < v->length; ++i) {
-        free(v->arr[i]);
+        allocator_free(v->allocator, vector_get(v, i));
     }
     vector_free_shallow(v);
 }
 
 // frees the vector but not the elements
 void vector_free_shallow(Vector* v) {
-    free(v->arr);
-    free(v);
+    if (v->heap != NULL) allocator_free(v->allocator, v->heap);
+    allocator_free(v->allocator, v);
 }
 
-void vector_push(Vector* v, void* elem) {
-    if (v->capacity == v->length) {
-        v->capacity *= 1.3;
+void vector_append(Vector* v, const void* elem) {
+    grow_to(v, v->length + 1);
 
-        if (v->capacity == v->length) {  // can happen due to integer rounding
-            v->capacity += 1;
-        }
+    memcpy(elements(v) + v->length * v->elem_size, elem, v->elem_size);
+    v->length += 1;
+}
 
-        v->arr = realloc(v->arr, sizeof(void*) * v->capacity);
-    }
+void vector_push(Vector* v, void* elem) {
+    vector_append(v, &elem);
+}
 
-    v->arr[v->length] = elem;
-    v->length += 1;
+void vector_push_many(Vector* v, const void* elems, size_t count) {
+    grow_to(v, v->length + count);
+
+    memcpy(elements(v) + v->length * v->elem_size, elems, count * v->elem_size);
+    v->length += count;
 }
 
-bool vector_pop(Vector* v, void** buffer) {
+bool vector_pop(Vector* v, void* buffer) {
     if (v->length > 0) {
-        *buffer = v->arr[v->length - 1];
         v->length -= 1;
+        memcpy(buffer, elements(v) + v->length * v->elem_size, v->elem_size);
         return true;
     }
     return false;
 }
 
 void* vector_get(Vector* v, size_t index) {
-    return v->arr[index];
+    return ((void**)elements(v))[index];
+}
+
+void* vector_at(Vector* v, size_t index) {
+    return elements(v) + index * v->elem_size;
+}
+
+void* vector_data(Vector* v) {
+    return elements(v);
+}
+
+void vector_reserve(Vector* v, size_t count) {
+    if (count > v->capacity) set_capacity(v, count);
+}
+
+void vector_shrink_to_fit(Vector* v) {
+    if (v->length < v->capacity) set_capacity(v, v->length);
 }
 
 size_t vector_size(Vector* v) {
     return v->length;
-}
\ No newline at end of file
+}
@@ -2,30 +2,79 @@
 #define _VECTOR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "allocator/allocator.h"
+
+// bytes of elements stored in the Vector itself, before anything is malloc'd
+#define VECTOR_INLINE_SIZE 64
+
+// Stores elements of a fixed size contiguously. Elements are kept in 'inline_storage' while
+// they fit, so short vectors on the stack don't allocate at all. Capacity doubles when full.
+// Vectors made by vector_new hold void*, see vector_push and vector_get
 typedef struct Vector {
-    void** arr;       // array of void*
-    size_t length;    // amount of elements stored
-    size_t capacity;  // amount of elements able to be stored at this point in time
+    Allocator* allocator;
+    char* heap;        // the elements once they don't fit inline anymore, NULL before
+    size_t elem_size;  // bytes per element
+    size_t length;     // amount of elements stored
+    size_t capacity;   // amount of elements able to be stored at this point in time
+    _Alignas(max_align_t) char inline_storage[VECTOR_INLINE_SIZE];
 } Vector;
 
+// mallocs a vector of void*
 Vector* vector_new(size_t initial_size);
 
+// mallocs a vector of elements of 'elem_size' bytes
+Vector* vector_new_typed(size_t elem_size, size_t initial_size);
+
+// like vector_new_typed, taking all memory from 'allocator'
+Vector* vector_new_with_allocator(size_t elem_size, size_t initial_size, Allocator* allocator);
+
+// sets up a vector that is not malloc'd, e.g. on the stack. Release it with vector_deinit
+void vector_init(Vector* v, size_t elem_size);
+
+// like vector_init, allocating from 'allocator' once the elements don't fit inline
+void vector_init_with_allocator(Vector* v, size_t elem_size, Allocator* allocator);
+
+// frees what a vector set up with vector_init allocated, but not the elements
+void vector_deinit(Vector* v);
+
+// frees the vector and every element, for vectors of void* from the vector's allocator
 void vector_free(Vector* v);
 
 // frees the vector, but not the elements
 void vector_free_shallow(Vector* v);
 
-// copies 'elem', does not take ownership
+// stores the pointer 'elem', for vectors of void*. Neither copies the pointee nor takes ownership
 void vector_push(Vector* v, void* elem);
 
-// removes last element, returns whether or not it succeeded
-bool vector_pop(Vector* v, void** buffer);
+// copies 'elem_size' bytes from 'elem' into a new element at the end
+void vector_append(Vector* v, const void* elem);
 
+// copies 'count' elements from 'elems' to the end
+void vector_push_many(Vector* v, const void* elems, size_t count);
+
+// removes last element and copies it into 'buffer'
+// returns: whether or not it succeeded
+bool vector_pop(Vector* v, void* buffer);
+
+// returns: the pointer stored at 'index', for vectors of void*
 void* vector_get(Vector* v, size_t index);
 
+// returns: address of the element at 'index'. Only valid until the vector grows
+void* vector_at(Vector* v, size_t index);
+
+// returns: address of the first element. Only valid until the vector grows
+void* vector_data(Vector* v);
+
+// grows the vector so that 'count' elements fit without growing again
+void vector_reserve(Vector* v, size_t count);
+
+// frees unused capacity, moving the elements back inline if they fit
+void vector_shrink_to_fit(Vector* v);
+
 size_t vector_size(Vector* v);
 
-#endif  //_VECTOR_H
\ No newline at end of file
+#endif  //_VECTOR_H
@@ -0,0 +1,465 @@
+// for mmap and friends
+#define _POSIX_C_SOURCE 200809L
+
+#include "ast_cache.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "parser.h"
+
+#define CACHE_MAGIC "CEQC"
+#define CACHE_VERSION 2
+
+#ifdef DEBUG
+#define CACHE_DEBUG_FLAG 1
+#else
+#define CACHE_DEBUG_FLAG 0
+#endif
+
+// the node layout differs between debug and release builds and between compilers
+#define CACHE_BUILD (((uint64_t)sizeof(ParseNode) << 1) | CACHE_DEBUG_FLAG)
+
+// File layout: header, data, relocations.
+// Every pointer in the data is stored as its offset into the data plus one, so that NULL stays 0.
+// The relocations list the offset of every pointer, so loading is a single pass over them.
+typedef struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t build;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint64_t root;  // offset of the root node in the data
+    uint64_t data_size;
+    uint64_t reloc_count;
+} CacheHeader;
+
+// FNV-1a
+static uint64_t hash_source(char* source, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char)source[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+char* ast_cache_path(char* script_path, char* cache_dir) {
+    char* name = script_path;
+    if (cache_dir != NULL) {
+        char* slash = strrchr(script_path, '/');
+        if (slash != NULL) name = slash + 1;
+    }
+
+    size_t dir_len = cache_dir == NULL ? 0 : strlen(cache_dir) + 1;
+    size_t name_len = strlen(name);
+    char* result = malloc(sizeof(char) * (dir_len + name_len + 6));  // room for ".ceqc" and '\0'
+
+    result[0] = '\0';
+    if (cache_dir != NULL) {
+        strcpy(result, cache_dir);
+        strcat(result, "/");
+    }
+    strcat(result, name);
+
+    // "script.ceq" becomes "script.ceqc", anything else gets ".ceqc" appended
+    if (name_len >= 4 && strcmp(name + name_len - 4, ".ceq") == 0)
+        strcat(result, "c");
+    else
+        strcat(result, ".ceqc");
+
+    return result;
+}
+
+// ----- saving -----
+
+typedef struct Buffer {
+    char* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef struct NodeOffset {
+    ParseNode* node;
+    uint64_t offset;
+} NodeOffset;
+
+typedef struct Writer {
+    Buffer data;
+    Buffer relocs;        // uint64_t offsets of pointers in data
+    Buffer node_offsets;  // NodeOffset for every node written
+    Buffer borrowed;      // NodeOffset of pointers that refer to a node written elsewhere
+} Writer;
+
+static void buffer_reserve(Buffer* buffer, size_t extra) {
+    if (buffer->size + extra <= buffer->capacity) return;
+
+    size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+    while (capacity < buffer->size + extra) capacity *= 2;
+
+    buffer->data = realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+static void buffer_append(Buffer* buffer, void* data, size_t size) {
+    buffer_reserve(buffer, size);
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+// returns: offset of the new, zeroed, 8 byte aligned block
+static uint64_t emit(Writer* writer, size_t size) {
+    size_t aligned = (size + 7) & ~(size_t)7;
+    buffer_reserve(&writer->data, aligned);
+
+    uint64_t offset = writer->data.size;
+    memset(writer->data.data + offset, 0, aligned);
+    writer->data.size += aligned;
+    return offset;
+}
+
+// stores a pointer to 'target' at 'at', both offsets into the data
+static void set_pointer(Writer* writer, uint64_t at, uint64_t target) {
+    uint64_t value = target + 1;
+    memcpy(writer->data.data + at, &value, sizeof(uint64_t));
+    buffer_append(&writer->relocs, &at, sizeof(uint64_t));
+}
+
+static void write_string(Writer* writer, uint64_t at, char* string) {
+    size_t size = strlen(string) + 1;
+    uint64_t offset = emit(writer, size);
+    memcpy(writer->data.data + offset, string, size);
+    set_pointer(writer, at, offset);
+}
+
+static uint64_t write_node(Writer* writer, ParseNode* node);
+
+static void write_child(Writer* writer, uint64_t at, ParseNode* child) {
+    if (child == NULL) return;
+    uint64_t offset = write_node(writer, child);
+    set_pointer(writer, at, offset);
+}
+
+static void write_node_array(Writer* writer, uint64_t at, ParseNode** nodes, size_t count) {
+    if (count == 0) return;
+    uint64_t array = emit(writer, sizeof(ParseNode*) * count);
+    set_pointer(writer, at, array);
+    for (size_t i = 0; i < count; ++i) {
+        write_child(writer, array + i * sizeof(ParseNode*), nodes[i]);
+    }
+}
+
+static void write_borrowed(Writer* writer, uint64_t at, ParseNode* node) {
+    if (node == NULL) return;
+    NodeOffset pending = {node, at};
+    buffer_append(&writer->borrowed, &pending, sizeof(NodeOffset));
+}
+
+#define FIELD(node_offset, member) ((node_offset) + offsetof(ParseNode, member))
+
+static uint64_t write_node(Writer* writer, ParseNode* node) {
+    uint64_t offset = emit(writer, sizeof(ParseNode));
+    memcpy(writer->data.data + offset, node, sizeof(ParseNode));
+
+    NodeOffset written = {node, offset};
+    buffer_append(&writer->node_offsets, &written, sizeof(NodeOffset));
+
+    // clear every pointer, then write the ones that are set
+    ParseNode* copy = (ParseNode*)(writer->data.data + offset);
+    switch (node->type) {
+        case N_ROOT:
+            copy->root_info.definitions = NULL;
+            write_node_array(writer, FIELD(offset, root_info.definitions), node->root_info.definitions, node->root_info.count);
+            break;
+        case N_FUNC_DEF: {
+            FuncDefNode* info = node->func_def_info;
+            uint64_t info_offset = emit(writer, sizeof(FuncDefNode));
+            set_pointer(writer, FIELD(offset, func_def_info), info_offset);
+
+            // everything but the count is a pointer, and the block starts out zeroed
+            size_t count = info->param_count;
+            ((FuncDefNode*)(writer->data.data + info_offset))->param_count = count;
+
+            write_string(writer, info_offset + offsetof(FuncDefNode, name), info->name);
+            write_child(writer, info_offset + offsetof(FuncDefNode, statement), info->statement);
+
+            if (count > 0) {
+                uint64_t params = emit(writer, sizeof(char*) * count);
+                set_pointer(writer, info_offset + offsetof(FuncDefNode, params), params);
+                for (size_t i = 0; i < count; ++i) {
+                    write_string(writer, params + i * sizeof(char*), info->params[i]);
+                }
+            }
+            break;
+        }
+        case N_VAR_DEF:
+            copy->var_def_info.name = NULL;
+            copy->var_def_info.initial_val = NULL;
+            write_string(writer, FIELD(offset, var_def_info.name), node->var_def_info.name);
+            write_child(writer, FIELD(offset, var_def_info.initial_val), node->var_def_info.initial_val);
+            break;
+        case N_ARR_DEF:
+            copy->arr_def_info.name = NULL;
+            copy->arr_def_info.size = NULL;
+            write_string(writer, FIELD(offset, arr_def_info.name), node->arr_def_info.name);
+            write_child(writer, FIELD(offset, arr_def_info.size), node->arr_def_info.size);
+            break;
+        case N_FUNC_CALL:
+            copy->func_call_info.name = NULL;
+            copy->func_call_info.params = NULL;
+            write_string(writer, FIELD(offset, func_call_info.name), node->func_call_info.name);
+            write_node_array(writer, FIELD(offset, func_call_info.params), node->func_call_info.params, node->func_call_info.param_count);
+            break;
+        case N_BIN_OP:
+            copy->bin_operation_info.left = NULL;
+            copy->bin_operation_info.right = NULL;
+            write_child(writer, FIELD(offset, bin_operation_info.left), node->bin_operation_info.left);
+            write_child(writer, FIELD(offset, bin_operation_info.right), node->bin_operation_info.right);
+            break;
+        case N_UN_OP:
+            copy->un_operation_info.operand = NULL;
+            write_child(writer, FIELD(offset, un_operation_info.operand), node->un_operation_info.operand);
+            break;
+        case N_NUMBER:
+            break;
+        case N_STRING:
+            copy->string_info.contents = NULL;
+            write_string(writer, FIELD(offset, string_info.contents), node->string_info.contents);
+            break;
+        case N_VARIABLE:
+            copy->variable_info.name = NULL;
+            write_string(writer, FIELD(offset, variable_info.name), node->variable_info.name);
+            break;
+        case N_IF:
+        case N_WHILE:
+            copy->conditional_info.condition = NULL;
+            copy->conditional_info.statement = NULL;
+            copy->conditional_info.else_statement = NULL;
+            copy->conditional_info.profile = NULL;
+            write_child(writer, FIELD(offset, conditional_info.condition), node->conditional_info.condition);
+            write_child(writer, FIELD(offset, conditional_info.statement), node->conditional_info.statement);
+            write_child(writer, FIELD(offset, conditional_info.else_statement), node->conditional_info.else_statement);
+            break;
+        case N_COMPOUND:
+            copy->compound_info.statements = NULL;
+            write_node_array(writer, FIELD(offset, compound_info.statements), node->compound_info.statements, node->compound_info.statement_amt);
+            break;
+        case N_RETURN:
+            copy->return_info.value = NULL;
+            write_child(writer, FIELD(offset, return_info.value), node->return_info.value);
+            break;
+        case N_VEC_LOOP: {
+            VecLoopNode* info = node->vec_loop_info;
+            uint64_t info_offset = emit(writer, sizeof(VecLoopNode));
+            set_pointer(writer, FIELD(offset, vec_loop_info), info_offset);
+
+            VecLoopNode* info_copy = (VecLoopNode*)(writer->data.data + info_offset);
+            info_copy->kind = info->kind;
+            info_copy->op = info->op;
+            info_copy->lhs_is_array = info->lhs_is_array;
+            info_copy->rhs_is_array = info->rhs_is_array;
+
+            write_child(writer, info_offset + offsetof(VecLoopNode, fallback), info->fallback);
+
+            // these point into the fallback, they are resolved once everything has been written
+            write_borrowed(writer, info_offset + offsetof(VecLoopNode, index), info->index);
+            write_borrowed(writer, info_offset + offsetof(VecLoopNode, limit), info->limit);
+            write_borrowed(writer, info_offset + offsetof(VecLoopNode, dest), info->dest);
+            write_borrowed(writer, info_offset + offsetof(VecLoopNode, lhs), info->lhs);
+            write_borrowed(writer, info_offset + offsetof(VecLoopNode, rhs), info->rhs);
+            break;
+        }
+#ifdef DEBUG
+        case N_DEBUG:
+            break;
+#endif
+    }
+
+    return offset;
+}
+
+static int compare_node_offsets(const void* a, const void* b) {
+    const NodeOffset* left = a;
+    const NodeOffset* right = b;
+    if (left->node == right->node) return 0;
+    return (uintptr_t)left->node < (uintptr_t)right->node ? -1 : 1;
+}
+
+static bool resolve_borrowed(Writer* writer) {
+    NodeOffset* nodes = (NodeOffset*)writer->node_offsets.data;
+    size_t node_amt = writer->node_offsets.size / sizeof(NodeOffset);
+    qsort(nodes, node_amt, sizeof(NodeOffset), compare_node_offsets);
+
+    NodeOffset* borrowed = (NodeOffset*)writer->borrowed.data;
+    size_t borrowed_amt = writer->borrowed.size / sizeof(NodeOffset);
+    for (size_t i = 0; i < borrowed_amt; ++i) {
+        NodeOffset* target = bsearch(&borrowed[i], nodes, node_amt, sizeof(NodeOffset), compare_node_offsets);
+        if (target == NULL) return false;
+        set_pointer(writer, borrowed[i].offset, target->offset);
+    }
+    return true;
+}
+
+bool ast_cache_save(char* cache_path, ParseNode* root, char* source, size_t source_size) {
+    Writer writer = {0};
+    uint64_t root_offset = write_node(&writer, root);
+    bool success = resolve_borrowed(&writer);
+
+    CacheHeader header = {0};
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.build = CACHE_BUILD;
+    header.source_hash = hash_source(source, source_size);
+    header.source_size = source_size;
+    header.root = root_offset;
+    header.data_size = writer.data.size;
+    header.reloc_count = writer.relocs.size / sizeof(uint64_t);
+
+    // write next to the destination first, so a concurrent run never sees half a file
+    size_t path_len = strlen(cache_path);
+    char* temp_path = malloc(sizeof(char) * (path_len + 5));
+    strcpy(temp_path, cache_path);
+    strcat(temp_path, ".tmp");
+
+    FILE* file = success ? fopen(temp_path, "wb") : NULL;
+    if (file != NULL) {
+        success = fwrite(&header, sizeof(CacheHeader), 1, file) == 1 &&
+                  fwrite(writer.data.data, 1, writer.data.size, file) == writer.data.size &&
+                  fwrite(writer.relocs.data, 1, writer.relocs.size, file) == writer.relocs.size;
+        success = fclose(file) == 0 && success;
+        success = success && rename(temp_path, cache_path) == 0;
+        if (!success) remove(temp_path);
+    } else {
+        success = false;
+    }
+
+    free(temp_path);
+    free(writer.data.data);
+    free(writer.relocs.data);
+    free(writer.node_offsets.data);
+    free(writer.borrowed.data);
+    return success;
+}
+
+// ----- loading -----
+
+static char* loaded_base = NULL;
+static size_t loaded_size = 0;
+
+static char* map_cache_file(char* cache_path, size_t* size) {
+#if defined(WINDOWS)
+    FILE* file = fopen(cache_path, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0L, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+    if (file_size <= 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    char* result = malloc(file_size);
+    if (fread(result, 1, file_size, file) != (size_t)file_size) {
+        free(result);
+        result = NULL;
+    }
+    fclose(file);
+
+    *size = file_size;
+    return result;
+#else
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // private and writable: pointers are fixed up in place, which never reaches the file
+    void* result = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (result == MAP_FAILED) return NULL;
+
+    *size = info.st_size;
+    return result;
+#endif
+}
+
+static void unmap_cache_file(char* base, size_t size) {
+#if defined(WINDOWS)
+    (void)size;
+    free(base);
+#else
+    munmap(base, size);
+#endif
+}
+
+ParseNode* ast_cache_load(char* cache_path, char* source, size_t source_size) {
+    size_t file_size;
+    char* base = map_cache_file(cache_path, &file_size);
+    if (base == NULL) return NULL;
+
+    CacheHeader* header = (CacheHeader*)base;
+    char* data = base + sizeof(CacheHeader);
+    uint64_t* relocs = (uint64_t*)(data + (file_size >= sizeof(CacheHeader) ? header->data_size : 0));
+
+    bool valid = file_size >= sizeof(CacheHeader) &&
+                 memcmp(header->magic, CACHE_MAGIC, 4) == 0 &&
+                 header->version == CACHE_VERSION &&
+                 header->build == CACHE_BUILD &&
+                 header->source_size == source_size &&
+                 header->data_size % 8 == 0 &&
+                 header->data_size <= file_size - sizeof(CacheHeader) &&
+                 header->reloc_count == (file_size - sizeof(CacheHeader) - header->data_size) / sizeof(uint64_t) &&
+                 header->root + sizeof(ParseNode) <= header->data_size &&
+                 header->source_hash == hash_source(source, source_size);
+
+    for (uint64_t i = 0; valid && i < header->reloc_count; ++i) {
+        uint64_t at = relocs[i];
+        if (at % 8 != 0 || at + sizeof(uint64_t) > header->data_size) {
+            valid = false;
+            break;
+        }
+
+        uint64_t value;
+        memcpy(&value, data + at, sizeof(uint64_t));
+        if (value == 0 || value - 1 >= header->data_size) {
+            valid = false;
+            break;
+        }
+
+        char* pointer = data + value - 1;
+        memcpy(data + at, &pointer, sizeof(char*));
+    }
+
+    if (!valid) {
+        unmap_cache_file(base, file_size);
+        return NULL;
+    }
+
+    loaded_base = base;
+    loaded_size = file_size;
+    return (ParseNode*)(data + header->root);
+}
+
+void ast_cache_release(ParseNode* root) {
+    (void)root;
+    if (loaded_base == NULL) return;
+
+    unmap_cache_file(loaded_base, loaded_size);
+    loaded_base = NULL;
+    loaded_size = 0;
+}
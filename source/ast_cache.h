@@ -0,0 +1,26 @@
+#ifndef _AST_CACHE_H
+#define _AST_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "parser.h"
+
+// Cache files (.ceqc) hold a parsed and optimized tree, so the tokenizer and parser can be
+// skipped when the source hasn't changed. A file is only used when it was written by the same
+// format version and build flavour, for a source with the same hash.
+
+// returns: path of the cache file for a script, either next to it or in 'cache_dir' when that
+// isn't NULL. The result has to be freed
+char* ast_cache_path(char* script_path, char* cache_dir);
+
+// returns: the tree stored for this source, or NULL if there is no valid cache file.
+// A loaded tree has to be released with ast_cache_release instead of free_AST
+ParseNode* ast_cache_load(char* cache_path, char* source, size_t source_size);
+
+// returns: success or not
+bool ast_cache_save(char* cache_path, ParseNode* root, char* source, size_t source_size);
+
+void ast_cache_release(ParseNode* root);
+
+#endif  // _AST_CACHE_H
@@ -1,14 +1,34 @@
+// for read and write
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(WINDOWS)
+#include <io.h>
+#define read _read
+#define write _write
+#else
+#include <unistd.h>
+#endif
 
+#include "heap.h"
+#include "input.h"
 #include "interpreter.h"
+#include "kernels.h"
+#include "mapped_file.h"
+#include "maps.h"
+#include "output.h"
+#include "sort.h"
 #include "xplatform.h"
 
 int64_t builtin_print(builtin_panic_func_t panic, int64_t count, int64_t* params) {
     if (count != 1) panic("Expected exactly 1 parameter");
 
-    printf(INT64_FORMAT "\n", params[0]);
+    output_int_line(params[0]);
 
     return 0;
 }
@@ -16,7 +36,7 @@ int64_t builtin_print(builtin_panic_func_t panic, int64_t count, int64_t* params
 int64_t builtin_printu(builtin_panic_func_t panic, int64_t count, int64_t* params) {
     if (count != 1) panic("Expected exactly 1 parameter");
 
-    printf(UINT64_FORMAT "\n", (uint64_t)(params[0]));
+    output_uint_line((uint64_t)(params[0]));
 
     return 0;
 }
@@ -24,7 +44,7 @@ int64_t builtin_printu(builtin_panic_func_t panic, int64_t count, int64_t* param
 int64_t builtin_putc(builtin_panic_func_t panic, int64_t count, int64_t* params) {
     if (count != 1) panic("Expected exactly 1 parameter");
 
-    printf("%c", (char)params[0]);
+    output_char((char)params[0]);
 
     return 0;
 }
@@ -33,7 +53,8 @@ int64_t builtin_puts(builtin_panic_func_t panic, int64_t count, int64_t* params)
     if (count != 1) panic("Expected exactly 1 parameter");
 
     char* string = (char*)(params[0]);
-    printf("%s\n", string);
+    output_string(string, strlen(string));
+    output_char('\n');
     return 0;
 }
 
@@ -41,12 +62,478 @@ int64_t builtin_input_num(builtin_panic_func_t panic, int64_t count, int64_t* pa
     if (count != 0) panic("Expected exactly 0 parameters");
     (void)params;
 
-    printf(" > ");
+    if (input_is_batch()) {
+        int64_t value;
+        return input_read_int(&value) ? value : 0;
+    }
+
+    // the prompt and everything before it has to be visible before waiting for input
+    output_string(" > ", 3);
+    output_flush();
 
     char buffer[11];
-    if (fgets(buffer, 11, stdin) != NULL) {
+    if (input_read_line(buffer, 11)) {
         return atoi(buffer);
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+// read_ints(array, max): reads up to 'max' numbers separated by whitespace from stdin
+// returns: amount of numbers read, 0 at the end of the input or if the next word isn't a number
+int64_t builtin_read_ints(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+    if (params[1] < 0) panic("Maximum must not be negative");
+    if (params[0] == 0 && params[1] > 0) panic("Pointer must not be 0");
+
+    return input_read_ints((int64_t*)params[0], params[1]);
+}
+
+// ----- bulk I/O -----
+
+// bytes of formatted numbers collected before write_ints writes them to a descriptor
+#define INT_WRITE_BUFFER_SIZE (16 * 1024)
+
+// returns: amount of bytes written, or -1 if nothing could be written
+static int64_t write_fd(int64_t fd, char* data, int64_t length) {
+    // stdout goes through the output buffer, so it stays in order with print and putc
+    if (fd == 1) {
+        output_string(data, length);
+        return length;
+    }
+
+    // anything printed so far has to come first, e.g. when stderr and stdout are the same file
+    output_flush();
+
+    int64_t done = 0;
+    while (done < length) {
+        int64_t result = write(fd, data + done, length - done);
+        if (result <= 0) return done > 0 ? done : -1;
+        done += result;
+    }
+    return done;
+}
+
+// reads until 'length' bytes have been read or the input ends
+// returns: amount of bytes read, or -1 if nothing could be read
+static int64_t read_fd(int64_t fd, char* data, int64_t length) {
+    // stdin is shared with input_num and read_ints
+    if (fd == 0) return input_read_bytes(data, length);
+
+    int64_t done = 0;
+    while (done < length) {
+        int64_t result = read(fd, data + done, length - done);
+        if (result < 0) return done > 0 ? done : -1;
+        if (result == 0) break;
+        done += result;
+    }
+    return done;
+}
+
+static void check_range(builtin_panic_func_t panic, int64_t pointer, int64_t length) {
+    if (length < 0) panic("Length must not be negative");
+    if (pointer == 0 && length > 0) panic("Pointer must not be 0");
+}
+
+// returns: whether ranges of 'length' int64 elements starting at 'a' and 'b' share memory
+static bool ranges_overlap(int64_t a, int64_t b, int64_t length) {
+    // the ranges overlap if their starts are less than 'length' elements apart
+    uint64_t distance = (uint64_t)a > (uint64_t)b ? (uint64_t)a - (uint64_t)b : (uint64_t)b - (uint64_t)a;
+    return distance / sizeof(int64_t) < (uint64_t)length;
+}
+
+// write(fd, pointer, length): writes 'length' bytes starting at 'pointer'
+// returns: amount of bytes written, or -1 on error
+int64_t builtin_write(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[1], params[2]);
+
+    return write_fd(params[0], (char*)params[1], params[2]);
+}
+
+// write_ints(fd, array, count): writes 'count' numbers, one per line like print
+// returns: amount of numbers written, or -1 on error
+int64_t builtin_write_ints(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[1], params[2]);
+
+    int64_t fd = params[0];
+    int64_t* values = (int64_t*)params[1];
+    int64_t amt = params[2];
+
+    if (fd == 1) {
+        for (int64_t i = 0; i < amt; ++i) {
+            output_int_line(values[i]);
+        }
+        return amt;
+    }
+
+    char buffer[INT_WRITE_BUFFER_SIZE];
+    size_t buffered = 0;
+    for (int64_t i = 0; i < amt; ++i) {
+        if (buffered + OUTPUT_MAX_INT_LINE > INT_WRITE_BUFFER_SIZE) {
+            if (write_fd(fd, buffer, buffered) < (int64_t)buffered) return -1;
+            buffered = 0;
+        }
+        buffered += output_format_int_line(values[i], buffer + buffered);
+    }
+    if (buffered > 0 && write_fd(fd, buffer, buffered) < (int64_t)buffered) return -1;
+
+    return amt;
+}
+
+// read(fd, pointer, length): reads up to 'length' bytes, stopping early only at the end of the input
+// returns: amount of bytes read, 0 at the end of the input, or -1 on error
+int64_t builtin_read(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[1], params[2]);
+
+    return read_fd(params[0], (char*)params[1], params[2]);
+}
+
+// read_file(path, pointer, length): reads up to 'length' bytes from the start of a file
+// returns: amount of bytes read, or -1 if the file can't be read
+int64_t builtin_read_file(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    if (params[0] == 0) panic("Path must not be 0");
+    check_range(panic, params[1], params[2]);
+
+    FILE* file = fopen((char*)params[0], "rb");
+    if (file == NULL) return -1;
+
+    size_t result = fread((char*)params[1], 1, params[2], file);
+    bool failed = ferror(file);
+    fclose(file);
+
+    return failed ? -1 : (int64_t)result;
+}
+
+// write_file(path, pointer, length): replaces the contents of a file with 'length' bytes
+// returns: amount of bytes written, or -1 on error
+int64_t builtin_write_file(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    if (params[0] == 0) panic("Path must not be 0");
+    check_range(panic, params[1], params[2]);
+
+    FILE* file = fopen((char*)params[0], "wb");
+    if (file == NULL) return -1;
+
+    // an empty write may come with a 0 pointer, which fwrite must not get
+    size_t result = params[2] > 0 ? fwrite((char*)params[1], 1, params[2], file) : 0;
+    if (fclose(file) != 0) return -1;
+
+    return result == (size_t)params[2] ? (int64_t)result : -1;
+}
+
+// ----- memory -----
+
+// these count int64 elements, not bytes
+
+// memfill(pointer, value, count): sets 'count' elements to 'value'
+int64_t builtin_memfill(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[0], params[2]);
+
+    kernel_fill((int64_t*)params[0], params[1], params[2]);
+    return 0;
+}
+
+// memcopy(destination, source, count): copies 'count' elements, the ranges may overlap
+int64_t builtin_memcopy(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[0], params[2]);
+    check_range(panic, params[1], params[2]);
+
+    kernel_move((int64_t*)params[0], (int64_t*)params[1], params[2]);
+    return 0;
+}
+
+// memequal(a, b, count)
+// returns: 1 if the first 'count' elements of both are the same, otherwise 0
+int64_t builtin_memequal(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[0], params[2]);
+    check_range(panic, params[1], params[2]);
+
+    return kernel_equal((int64_t*)params[0], (int64_t*)params[1], params[2]);
+}
+
+// find(pointer, count, value)
+// returns: index of the first of 'count' elements that equals 'value', or -1
+int64_t builtin_find(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[0], params[1]);
+
+    return kernel_find((int64_t*)params[0], params[1], params[2]);
+}
+
+// ----- array math -----
+
+// like the memory builtins, these count int64 elements. Arithmetic wraps around like the
+// interpreter's. The destination of the element-wise builtins may be one of the sources, but
+// must not overlap them otherwise
+
+// arr_sum(pointer, count)
+int64_t builtin_arr_sum(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+    check_range(panic, params[0], params[1]);
+
+    return kernel_reduce(KOP_ADD, 0, (int64_t*)params[0], params[1]);
+}
+
+// arr_min(pointer, count): count has to be at least 1
+int64_t builtin_arr_min(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+    if (params[1] < 1) panic("Count must be at least 1");
+    check_range(panic, params[0], params[1]);
+
+    return kernel_min((int64_t*)params[0], params[1]);
+}
+
+// arr_max(pointer, count): count has to be at least 1
+int64_t builtin_arr_max(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+    if (params[1] < 1) panic("Count must be at least 1");
+    check_range(panic, params[0], params[1]);
+
+    return kernel_max((int64_t*)params[0], params[1]);
+}
+
+// arr_dot(a, b, count)
+// returns: the sum of a[i] * b[i]
+int64_t builtin_arr_dot(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[0], params[2]);
+    check_range(panic, params[1], params[2]);
+
+    return kernel_dot((int64_t*)params[0], (int64_t*)params[1], params[2]);
+}
+
+static int64_t elementwise(builtin_panic_func_t panic, enum KernelOp op, int64_t count, int64_t* params) {
+    if (count != 4) panic("Expected exactly 4 parameters");
+    for (int64_t i = 0; i < 3; ++i) check_range(panic, params[i], params[3]);
+    for (int64_t i = 1; i < 3; ++i) {
+        if (params[i] != params[0] && ranges_overlap(params[0], params[i], params[3])) {
+            panic("Destination must be a source or not overlap it");
+        }
+    }
+
+    kernel_binop_vv(op, (int64_t*)params[0], (int64_t*)params[1], (int64_t*)params[2], params[3]);
+    return 0;
+}
+
+// arr_add(destination, a, b, count): destination[i] = a[i] + b[i]
+int64_t builtin_arr_add(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    return elementwise(panic, KOP_ADD, count, params);
+}
+
+// arr_and(destination, a, b, count): destination[i] = a[i] & b[i]
+int64_t builtin_arr_and(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    return elementwise(panic, KOP_AND, count, params);
+}
+
+// arr_or(destination, a, b, count): destination[i] = a[i] | b[i]
+int64_t builtin_arr_or(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    return elementwise(panic, KOP_OR, count, params);
+}
+
+// arr_shift(destination, source, count, amount): destination[i] = source[i] << amount, a
+// negative amount shifts right like >>. Shifting by 64 or more moves every bit out, left
+// that gives 0 and right it gives 0 or -1 depending on the sign
+int64_t builtin_arr_shift(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 4) panic("Expected exactly 4 parameters");
+    check_range(panic, params[0], params[2]);
+    check_range(panic, params[1], params[2]);
+    if (params[0] != params[1] && ranges_overlap(params[0], params[1], params[2])) {
+        panic("Destination must be the source or not overlap it");
+    }
+
+    int64_t* destination = (int64_t*)params[0];
+    int64_t* source = (int64_t*)params[1];
+    int64_t amount = params[3];
+    // negated as unsigned so INT64_MIN doesn't overflow
+    uint64_t distance = amount >= 0 ? (uint64_t)amount : -(uint64_t)amount;
+    if (amount >= 0) {
+        if (distance < 64) {
+            kernel_binop_vs(KOP_SHL, destination, source, distance, params[2]);
+        } else {
+            kernel_binop_vs(KOP_AND, destination, source, 0, params[2]);
+        }
+    } else {
+        // shifting right by 63 already leaves only copies of the sign bit
+        kernel_binop_vs(KOP_SHR, destination, source, distance < 64 ? distance : 63, params[2]);
+    }
+    return 0;
+}
+
+// ----- sorting -----
+
+// sort(pointer, count): sorts 'count' elements in ascending order
+int64_t builtin_sort(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+    check_range(panic, params[0], params[1]);
+
+    sort_int64((int64_t*)params[0], NULL, params[1]);
+    return 0;
+}
+
+// sort_pairs(keys, values, count): sorts 'count' keys in ascending order and moves every value
+// along with its key. Values of equal keys keep their order, the arrays must not overlap
+int64_t builtin_sort_pairs(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[0], params[2]);
+    check_range(panic, params[1], params[2]);
+    if (ranges_overlap(params[0], params[1], params[2])) panic("Keys and values must not overlap");
+
+    sort_int64((int64_t*)params[0], (int64_t*)params[1], params[2]);
+    return 0;
+}
+
+// bsearch(pointer, count, value): searches 'count' elements sorted in ascending order
+// returns: index of the first element that equals 'value', or -1
+int64_t builtin_bsearch(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+    check_range(panic, params[0], params[1]);
+
+    return sort_search((int64_t*)params[0], params[1], params[2]);
+}
+
+// ----- mapped files -----
+
+// map_file(path, writable): maps a whole file into memory, so it can be read through the pointer
+// like an array. With 'writable' set, changes are written back to the file, otherwise they
+// only stay in memory
+// returns: pointer to the start of the file, or 0 if it can't be mapped or is empty
+int64_t builtin_map_file(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+    if (params[0] == 0) panic("Path must not be 0");
+
+    return (intptr_t)mapped_file_map((char*)params[0], params[1] != 0);
+}
+
+// unmap(pointer): releases a mapping made by map_file. Files that are still mapped are unmapped at exit
+int64_t builtin_unmap(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 1) panic("Expected exactly 1 parameter");
+    if (!mapped_file_unmap((void*)(intptr_t)params[0])) panic("Pointer wasn't returned by map_file");
+
+    return 0;
+}
+
+// file_size(path)
+// returns: size of the file in bytes, or -1 if it doesn't exist
+int64_t builtin_file_size(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 1) panic("Expected exactly 1 parameter");
+    if (params[0] == 0) panic("Path must not be 0");
+
+    return mapped_file_size((char*)params[0]);
+}
+
+// ----- heap -----
+
+static void check_block(builtin_panic_func_t panic, int64_t pointer) {
+    if (!heap_is_block((void*)(intptr_t)pointer)) panic("Pointer wasn't returned by alloc or realloc, or was freed already");
+}
+
+// alloc(size): allocates 'size' bytes filled with zeroes, which stay valid until they are freed
+// returns: pointer to the first byte
+int64_t builtin_alloc(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 1) panic("Expected exactly 1 parameter");
+    if (params[0] < 0) panic("Size must not be negative");
+
+    void* result = heap_alloc(params[0]);
+    if (result == NULL) panic("Out of memory");
+    return (intptr_t)result;
+}
+
+// realloc(pointer, size): resizes a block, keeping its contents. Growing fills the new bytes
+// with zeroes, a pointer of 0 allocates a new block
+// returns: pointer to the block, which can have moved
+int64_t builtin_realloc(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+    if (params[1] < 0) panic("Size must not be negative");
+    if (params[0] != 0) check_block(panic, params[0]);
+
+    void* result = heap_realloc((void*)(intptr_t)params[0], params[1]);
+    if (result == NULL) panic("Out of memory");
+    return (intptr_t)result;
+}
+
+// free(pointer): frees a block from alloc or realloc, a pointer of 0 is ignored
+int64_t builtin_free(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 1) panic("Expected exactly 1 parameter");
+    if (params[0] == 0) return 0;
+    check_block(panic, params[0]);
+
+    heap_free((void*)(intptr_t)params[0]);
+    return 0;
+}
+
+// ----- maps -----
+
+#define UNKNOWN_MAP_MESSAGE "Handle wasn't returned by map_new, or the map was freed already"
+
+// returns: the map 'handle' stands for, panics if there is none
+static IntHashTable* get_map(builtin_panic_func_t panic, int64_t handle) {
+    IntHashTable* map = maps_get(handle);
+    if (map == NULL) panic(UNKNOWN_MAP_MESSAGE);
+    return map;
+}
+
+// map_new(): creates an empty map from numbers to numbers
+// returns: a handle for the other map builtins
+int64_t builtin_map_new(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 0) panic("Expected exactly 0 parameters");
+    (void)params;
+
+    return maps_new();
+}
+
+// map_set(map, key, value): adds the key or replaces its value
+int64_t builtin_map_set(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+
+    int_hashtable_set(get_map(panic, params[0]), params[1], params[2]);
+    return 0;
+}
+
+// map_get(map, key, default)
+// returns: the value of the key, or 'default' if it isn't in the map
+int64_t builtin_map_get(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 3) panic("Expected exactly 3 parameters");
+
+    int64_t value;
+    return int_hashtable_get(get_map(panic, params[0]), &value, params[1]) ? value : params[2];
+}
+
+// map_has(map, key)
+// returns: 1 if the key is in the map, otherwise 0
+int64_t builtin_map_has(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+
+    return int_hashtable_get_ptr(get_map(panic, params[0]), params[1]) != NULL;
+}
+
+// map_del(map, key)
+// returns: 1 if the key was in the map, otherwise 0
+int64_t builtin_map_del(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 2) panic("Expected exactly 2 parameters");
+
+    return int_hashtable_delete(get_map(panic, params[0]), params[1]);
+}
+
+// map_len(map)
+// returns: amount of keys in the map
+int64_t builtin_map_len(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 1) panic("Expected exactly 1 parameter");
+
+    return int_hashtable_count(get_map(panic, params[0]));
+}
+
+// map_free(map): frees the map, its handle can't be used anymore. Maps that are still there
+// are freed at exit
+int64_t builtin_map_free(builtin_panic_func_t panic, int64_t count, int64_t* params) {
+    if (count != 1) panic("Expected exactly 1 parameter");
+    if (!maps_free(params[0])) panic(UNKNOWN_MAP_MESSAGE);
+
+    return 0;
+}
@@ -15,4 +15,86 @@ int64_t builtin_puts(builtin_panic_func_t panic, int64_t count, int64_t* params)
 
 int64_t builtin_input_num(builtin_panic_func_t panic, int64_t count, int64_t* params);
 
+int64_t builtin_read_ints(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+// bulk I/O, see builtin_functions.c for the parameters
+
+int64_t builtin_write(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_write_ints(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_read(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_read_file(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_write_file(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+// memory
+
+int64_t builtin_memfill(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_memcopy(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_memequal(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_find(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+// array math
+
+int64_t builtin_arr_sum(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_arr_min(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_arr_max(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_arr_dot(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_arr_add(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_arr_and(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_arr_or(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_arr_shift(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+// sorting
+
+int64_t builtin_sort(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_sort_pairs(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_bsearch(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+// mapped files
+
+int64_t builtin_map_file(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_unmap(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_file_size(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+// heap
+
+int64_t builtin_alloc(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_realloc(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_free(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+// maps
+
+int64_t builtin_map_new(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_map_set(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_map_get(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_map_has(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_map_del(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_map_len(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
+int64_t builtin_map_free(builtin_panic_func_t panic, int64_t count, int64_t* params);
+
 #endif  // _BUILTIN_FUNCTIONS_H
\ No newline at end of file
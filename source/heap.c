@@ -0,0 +1,93 @@
+#include "heap.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator/allocator.h"
+#include "hashtable/hashtable.h"
+
+static Pool* pool = NULL;
+static PoolCache* cache = NULL;
+// every block that is allocated -> its size. The pool doesn't check pointers, so anything
+// passed in by the program is looked up here before the pool touches it
+static IntHashTable* blocks = NULL;
+static bool print_stats = false;
+
+void heap_init(bool stats) {
+    print_stats = stats;
+}
+
+// the pool is only set up once a program allocates
+static Allocator* heap_allocator() {
+    if (cache == NULL) {
+        pool = pool_new();
+        cache = pool_cache_new(pool);
+        blocks = int_hashtable_new(64);
+    }
+    return pool_cache_allocator(cache);
+}
+
+void* heap_alloc(int64_t size) {
+    void* result = allocator_alloc(heap_allocator(), size);
+    if (result == NULL) return NULL;
+
+    memset(result, 0, size);
+    int_hashtable_set(blocks, (intptr_t)result, size);
+    return result;
+}
+
+void* heap_realloc(void* pointer, int64_t size) {
+    if (pointer == NULL) return heap_alloc(size);
+
+    size_t old_size = pool_block_size(pointer);
+    char* result = allocator_realloc(heap_allocator(), pointer, old_size, size);
+    if (result == NULL) return NULL;
+
+    if ((size_t)size > old_size) memset(result + old_size, 0, size - old_size);
+    int_hashtable_delete(blocks, (intptr_t)pointer);
+    int_hashtable_set(blocks, (intptr_t)result, size);
+    return result;
+}
+
+void heap_free(void* pointer) {
+    if (pointer == NULL) return;
+
+    int_hashtable_delete(blocks, (intptr_t)pointer);
+    allocator_free(heap_allocator(), pointer);
+}
+
+bool heap_is_block(void* pointer) {
+    return blocks != NULL && int_hashtable_get_ptr(blocks, (intptr_t)pointer) != NULL;
+}
+
+static double percent(size_t part, size_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+static void heap_print_stats() {
+    PoolStats stats = {0};
+    if (cache != NULL) stats = pool_cache_stats(cache);
+
+    fprintf(stderr, "heap allocations: %10zu (%zu reallocations)\n", stats.allocations, stats.reallocations);
+    fprintf(stderr, "heap frees:       %10zu (%zu blocks still allocated)\n", stats.frees, stats.live_blocks);
+    fprintf(stderr, "heap peak:        %10zu bytes requested, %zu bytes in blocks, %zu bytes reserved\n",
+            stats.peak_live_bytes, stats.peak_class_bytes, stats.peak_reserved);
+    // internal: lost to rounding up to size classes, external: reserved but not in a block
+    fprintf(stderr, "heap fragmentation at peak: %.1f%% internal, %.1f%% external\n",
+            percent(stats.peak_class_bytes - stats.peak_live_bytes, stats.peak_class_bytes),
+            percent(stats.peak_reserved - stats.peak_class_bytes, stats.peak_reserved));
+}
+
+void heap_finish() {
+    if (print_stats) heap_print_stats();
+    if (cache == NULL) return;
+
+    pool_cache_free(cache);
+    pool_free(pool);
+    int_hashtable_free(blocks);
+    cache = NULL;
+    pool = NULL;
+    blocks = NULL;
+}
@@ -0,0 +1,29 @@
+#ifndef _HEAP_H
+#define _HEAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Memory the interpreted program allocates with alloc, realloc and free. Blocks come from a
+// size class pool, so freeing and allocating again reuses them without going to malloc.
+
+// stats: print peak usage and fragmentation to stderr in heap_finish
+void heap_init(bool stats);
+
+// returns: a block of 'size' bytes, filled with zeroes like arrays are, or NULL when out of memory
+void* heap_alloc(int64_t size);
+
+// returns: the block moved to fit 'size' bytes, the bytes behind the old size are zeroes.
+// NULL when out of memory, the old block stays allocated then
+void* heap_realloc(void* pointer, int64_t size);
+
+void heap_free(void* pointer);
+
+// Looks the pointer up in the blocks that are allocated, without reading from it
+// returns: true if 'pointer' was returned by heap_alloc or heap_realloc and not freed since
+bool heap_is_block(void* pointer);
+
+// frees every block that is still allocated
+void heap_finish();
+
+#endif  // _HEAP_H
@@ -0,0 +1,182 @@
+// for read
+#define _POSIX_C_SOURCE 200809L
+
+#include "input.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WINDOWS)
+#include <io.h>
+#define read _read
+#else
+#include <unistd.h>
+#endif
+
+#include "output.h"
+
+#define INPUT_BUFFER_SIZE (1024 * 1024)
+
+// zeroes behind the buffered input, so 8 bytes can be loaded at any buffered position
+#define INPUT_PADDING 8
+
+static char buffer[INPUT_BUFFER_SIZE + INPUT_PADDING];
+static size_t start = 0;  // first byte that hasn't been read yet
+static size_t end = 0;    // end of the buffered input
+static bool at_end = false;
+static bool batch_mode = false;
+
+void input_init(bool batch) {
+    batch_mode = batch;
+}
+
+bool input_is_batch() {
+    return batch_mode;
+}
+
+// Moves the unread input to the front and reads more behind it. On a terminal this returns
+// once a line has been typed
+// returns: false at the end of the input
+static bool refill() {
+    if (at_end) return false;
+
+    memmove(buffer, buffer + start, end - start);
+    end -= start;
+    start = 0;
+
+    // only a single word of the whole buffer size gets here, it is cut off
+    if (end == INPUT_BUFFER_SIZE) return false;
+
+    // prompts have to be visible before waiting for input
+    if (!batch_mode) output_flush();
+
+    int64_t result = read(0, buffer + end, INPUT_BUFFER_SIZE - end);
+    if (result <= 0) {
+        at_end = true;
+        return false;
+    }
+
+    end += result;
+    memset(buffer + end, 0, INPUT_PADDING);
+    return true;
+}
+
+bool input_read_line(char* line, size_t size) {
+    size_t length = 0;
+    while (length + 1 < size) {
+        if (start == end && !refill()) break;
+
+        char c = buffer[start++];
+        line[length++] = c;
+        if (c == '\n') break;
+    }
+
+    line[length] = '\0';
+    return length > 0;
+}
+
+int64_t input_read_bytes(char* data, int64_t length) {
+    int64_t done = end - start < (size_t)length ? (int64_t)(end - start) : length;
+    memcpy(data, buffer + start, done);
+    start += done;
+
+    // the rest doesn't have to go through the buffer
+    while (done < length && !at_end) {
+        if (!batch_mode) output_flush();
+
+        int64_t result = read(0, data + done, length - done);
+        if (result < 0) return done > 0 ? done : -1;
+        if (result == 0) at_end = true;
+        done += result;
+    }
+    return done;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// Converts 8 digit characters at once: neighbouring digits are combined into pairs, pairs
+// into quadruples and those into the result, with one multiplication per step
+static uint64_t parse_eight_digits(const char* digits) {
+    uint64_t chunk;
+    memcpy(&chunk, digits, sizeof(chunk));
+
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >>
+            32;
+    return chunk;
+}
+#define HAVE_EIGHT_DIGIT_PARSING
+#endif
+
+static uint64_t parse_digits(const char* digits, size_t length) {
+    uint64_t result = 0;
+
+#ifdef HAVE_EIGHT_DIGIT_PARSING
+    while (length >= 8) {
+        result = result * 100000000 + parse_eight_digits(digits);
+        digits += 8;
+        length -= 8;
+    }
+#endif
+
+    while (length > 0) {
+        result = result * 10 + (*digits - '0');
+        ++digits;
+        --length;
+    }
+    return result;
+}
+
+bool input_read_int(int64_t* value) {
+    for (;;) {
+        while (start < end && is_space(buffer[start])) ++start;
+        if (start < end) break;
+        if (!refill()) return false;
+    }
+
+    // the whole number has to be buffered. Only a number that reaches the end of the
+    // buffered input can continue behind it
+    size_t number_end = start;
+    if (buffer[number_end] == '-' || buffer[number_end] == '+') ++number_end;
+    for (;;) {
+        while (number_end < end && is_digit(buffer[number_end])) ++number_end;
+        if (number_end < end) break;
+
+        // refilling moves the number to the front
+        size_t offset = number_end - start;
+        bool more = refill();
+        number_end = start + offset;
+        if (!more) break;
+    }
+
+    bool negative = buffer[start] == '-';
+    size_t digits_start = start + (negative || buffer[start] == '+');
+    if (digits_start == number_end) return false;  // not a number, left for the next read
+
+    // digits followed by anything else, like '5x', are a word that isn't a number either
+    if (number_end < end && !is_space(buffer[number_end])) return false;
+
+    uint64_t magnitude = parse_digits(buffer + digits_start, number_end - digits_start);
+    *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    start = number_end;
+    return true;
+}
+
+int64_t input_read_ints(int64_t* values, int64_t max) {
+    int64_t amt = 0;
+    while (amt < max && input_read_int(&values[amt])) {
+        ++amt;
+    }
+    return amt;
+}
@@ -0,0 +1,33 @@
+#ifndef _INPUT_H
+#define _INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Input of the interpreted program. Everything read from stdin goes through one large
+// buffer, so the builtins can be mixed without losing input to each other.
+
+// batch: the input is piped in rather than typed, so input_num doesn't prompt and reads
+// whole 64 bit numbers, and output isn't flushed before reading
+void input_init(bool batch);
+
+bool input_is_batch();
+
+// like fgets on stdin
+// returns: false if nothing could be read
+bool input_read_line(char* buffer, size_t size);
+
+// reads until 'length' bytes have been read or the input ends
+// returns: amount of bytes read, or -1 if nothing could be read because of an error
+int64_t input_read_bytes(char* data, int64_t length);
+
+// reads the next number, skipping whitespace in front of it. Numbers wrap around like
+// arithmetic does
+// returns: false at the end of the input or if the next word isn't a number
+bool input_read_int(int64_t* value);
+
+// returns: amount of numbers read into 'values', stops early like input_read_int
+int64_t input_read_ints(int64_t* values, int64_t max);
+
+#endif  // _INPUT_H
@@ -6,32 +6,47 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "allocator/allocator.h"
 #include "builtin_functions.h"
 #include "hashtable/hashtable.h"
+#include "kernels.h"
+#include "large_array.h"
+#include "mapped_file.h"
+#include "maps.h"
+#include "optimizer.h"
+#include "output.h"
 #include "parser.h"
+#include "profile.h"
 #include "tokenizer.h"
 #include "vector/vector.h"
 #include "xplatform.h"
 
-#define MAX_USER_FUNCTIONS 100
-#define MAX_BUILTIN_FUNCTIONS 100
 #define MAX_FUNCTION_NAME_LEN 100
-#define MAX_VARIABLE_AMT 100
-#define MAX_STR_AMT 100
+
+// initial sizes of the hashtables, they grow as needed
+#define INITIAL_FUNCTION_AMT 16
+#define INITIAL_VARIABLE_AMT 8
+#define INITIAL_STR_AMT 16
 
 #define MAX_CALL_DEPTH 100
 
+// bytes the scope arena mallocs at a time, enough for the scopes of a deep recursion
+#define SCOPE_ARENA_CHUNK_SIZE (64 * 1024)
+
 static int64_t visit_node(ParseNode* node);
 
 typedef struct UserFunc {
     int64_t param_count;
     char** params;
-    ParseNode* statement;
+    ParseNode* statement;   // NULL until the body of 'definition' has been parsed
+    ParseNode* definition;
+    NodeProfile* profile;
 } UserFunc;
 
 static int64_t user_function_ret_val = 0;     // return value for the user function currently running
 static bool user_function_returning = false;  // set to true by 'return' statement. Reset by 'call_func'
 static HashTable* user_functions;
+static IntHashTable* call_targets;  // call node -> UserFunc, so repeated calls don't hash the name
 
 typedef struct BuiltinFunc {
     char name[MAX_FUNCTION_NAME_LEN];
@@ -43,11 +58,24 @@ static HashTable* builtin_functions;
 static HashTable* global_variables;
 static Vector* var_scopes;
 
+// Scopes are destroyed in the reverse order they were created, so everything in them (the
+// table, its keys, the values and arrays) comes from an arena that is released to where it
+// was when the scope was created. Large arrays get pages of their own, which are released
+// the same way
+typedef struct ScopeMark {
+    ArenaMark arena;
+    size_t large_arrays;
+} ScopeMark;
+
+static Arena* scope_arena;
+static Vector scope_marks;  // ScopeMark for every scope in var_scopes
+
 // Start off in the global scope to make sure global variables are stored in the global hashmap
 static bool is_global_scope = true;
 static HashTable* global_strings;
 
 static void panic(char* message, int64_t line) {
+    output_flush();
     if (line >= 0)
         fprintf(stderr, "Error while interpreting on line " INT64_FORMAT ": %s\n", line, message);
     else
@@ -64,7 +92,10 @@ static void builtin_panic(char* message) {
 }
 
 static void var_scope_append() {
-    HashTable* new_scope = hashtable_new(ANY_T, MAX_VARIABLE_AMT);
+    ScopeMark mark = {arena_mark(scope_arena), large_array_mark()};
+    vector_append(&scope_marks, &mark);
+
+    HashTable* new_scope = hashtable_new_with_allocator(ANY_T, INITIAL_VARIABLE_AMT, LAYOUT_LINEAR, arena_allocator(scope_arena));
     vector_push(var_scopes, new_scope);
     hashtable_force_free_values(new_scope);
 }
@@ -78,6 +109,17 @@ static void var_scope_destroy() {
     void* to_destroy;
     vector_pop(var_scopes, &to_destroy);
     hashtable_free((HashTable*)to_destroy);
+
+    ScopeMark mark;
+    vector_pop(&scope_marks, &mark);
+    arena_release(scope_arena, mark.arena);
+    large_array_release(mark.large_arrays);
+}
+
+// returns: the allocator for values of variables defined in the current scope
+static Allocator* var_allocator() {
+    if (is_global_scope) return global_variables->allocator;
+    return var_scope_get_current()->allocator;
 }
 
 static int64_t* var_get_addr(ParseNode* node) {
@@ -129,7 +171,7 @@ static void var_insert_ptr(char* name, int64_t* ptr, int64_t line) {
 }
 
 static void var_define_manual(char* name, int64_t value, int64_t line) {
-    int64_t* ptr = malloc(sizeof(int64_t));
+    int64_t* ptr = allocator_alloc(var_allocator(), sizeof(int64_t));
     *ptr = value;
     var_insert_ptr(name, ptr, line);
 }
@@ -215,22 +257,58 @@ static int64_t str_get_ptr(ParseNode* str_node) {
 }
 
 static void init_funcs() {
-    builtin_functions = hashtable_new(ANY_T, MAX_BUILTIN_FUNCTIONS);
+    builtin_functions = hashtable_new(ANY_T, INITIAL_FUNCTION_AMT);
     hashtable_set(builtin_functions, "print", builtin_print);
     hashtable_set(builtin_functions, "printu", builtin_printu);
     hashtable_set(builtin_functions, "putc", builtin_putc);
     hashtable_set(builtin_functions, "puts", builtin_puts);
     hashtable_set(builtin_functions, "input_num", builtin_input_num);
-
-    user_functions = hashtable_new(ANY_T, MAX_USER_FUNCTIONS);
+    hashtable_set(builtin_functions, "read_ints", builtin_read_ints);
+    hashtable_set(builtin_functions, "write", builtin_write);
+    hashtable_set(builtin_functions, "write_ints", builtin_write_ints);
+    hashtable_set(builtin_functions, "read", builtin_read);
+    hashtable_set(builtin_functions, "read_file", builtin_read_file);
+    hashtable_set(builtin_functions, "write_file", builtin_write_file);
+    hashtable_set(builtin_functions, "memfill", builtin_memfill);
+    hashtable_set(builtin_functions, "memcopy", builtin_memcopy);
+    hashtable_set(builtin_functions, "memequal", builtin_memequal);
+    hashtable_set(builtin_functions, "find", builtin_find);
+    hashtable_set(builtin_functions, "arr_sum", builtin_arr_sum);
+    hashtable_set(builtin_functions, "arr_min", builtin_arr_min);
+    hashtable_set(builtin_functions, "arr_max", builtin_arr_max);
+    hashtable_set(builtin_functions, "arr_dot", builtin_arr_dot);
+    hashtable_set(builtin_functions, "arr_add", builtin_arr_add);
+    hashtable_set(builtin_functions, "arr_and", builtin_arr_and);
+    hashtable_set(builtin_functions, "arr_or", builtin_arr_or);
+    hashtable_set(builtin_functions, "arr_shift", builtin_arr_shift);
+    hashtable_set(builtin_functions, "sort", builtin_sort);
+    hashtable_set(builtin_functions, "sort_pairs", builtin_sort_pairs);
+    hashtable_set(builtin_functions, "bsearch", builtin_bsearch);
+    hashtable_set(builtin_functions, "map_file", builtin_map_file);
+    hashtable_set(builtin_functions, "unmap", builtin_unmap);
+    hashtable_set(builtin_functions, "file_size", builtin_file_size);
+    hashtable_set(builtin_functions, "alloc", builtin_alloc);
+    hashtable_set(builtin_functions, "realloc", builtin_realloc);
+    hashtable_set(builtin_functions, "free", builtin_free);
+    hashtable_set(builtin_functions, "map_new", builtin_map_new);
+    hashtable_set(builtin_functions, "map_set", builtin_map_set);
+    hashtable_set(builtin_functions, "map_get", builtin_map_get);
+    hashtable_set(builtin_functions, "map_has", builtin_map_has);
+    hashtable_set(builtin_functions, "map_del", builtin_map_del);
+    hashtable_set(builtin_functions, "map_len", builtin_map_len);
+    hashtable_set(builtin_functions, "map_free", builtin_map_free);
+
+    user_functions = hashtable_new(ANY_T, INITIAL_FUNCTION_AMT);
 
     // we malloc our own user functions to put in the hashtable
     // make sure they get freed when the hashtable is freed
     hashtable_force_free_values(user_functions);
+
+    call_targets = int_hashtable_new(INITIAL_FUNCTION_AMT);
 }
 
 static void init_strings() {
-    global_strings = hashtable_new(INT_T, MAX_STR_AMT);
+    global_strings = hashtable_new(INT_T, INITIAL_STR_AMT);
 }
 
 static void free_strings() {
@@ -239,21 +317,45 @@ static void free_strings() {
 
 static void func_define(ParseNode* func_def_node) {
     UserFunc* new_func = malloc(sizeof(UserFunc));
-    new_func->param_count = func_def_node->func_def_info.param_count;
-    new_func->params = func_def_node->func_def_info.params;
-    new_func->statement = func_def_node->func_def_info.statement;
+    new_func->param_count = func_def_node->func_def_info->param_count;
+    new_func->params = func_def_node->func_def_info->params;
+    new_func->statement = func_def_node->func_def_info->statement;
+    new_func->definition = func_def_node;
+    new_func->profile = func_def_node->func_def_info->profile;
+
+    // global initialisers can call functions before every definition has been seen, and a
+    // redefinition replaces the old function
+    int_hashtable_clear(call_targets);
 
-    if (!hashtable_set(user_functions, func_def_node->func_def_info.name, new_func)) {
+    if (!hashtable_set(user_functions, func_def_node->func_def_info->name, new_func)) {
         char buffer[100];
-        snprintf(buffer, 100, "Unable to define function %s", func_def_node->func_def_info.name);
+        snprintf(buffer, 100, "Unable to define function %s", func_def_node->func_def_info->name);
         panic(buffer, func_def_node->line);
     }
 }
 
-static int64_t call_func(ParseNode* call_node) {
+// returns: the user function a call refers to, or NULL if there is none
+static UserFunc* find_user_func(ParseNode* call_node) {
+    int64_t cached;
+    if (int_hashtable_get(call_targets, &cached, (int64_t)(intptr_t)call_node)) return (UserFunc*)(intptr_t)cached;
+
     HashEntry buffer;
-    if (hashtable_get(user_functions, &buffer, call_node->func_call_info.name)) {
-        UserFunc* user_func = buffer.value;
+    if (!hashtable_get(user_functions, &buffer, call_node->func_call_info.name)) return NULL;
+
+    int_hashtable_set(call_targets, (int64_t)(intptr_t)call_node, (int64_t)(intptr_t)buffer.value);
+    return buffer.value;
+}
+
+static int64_t call_func(ParseNode* call_node) {
+    UserFunc* user_func = find_user_func(call_node);
+    if (user_func != NULL) {
+        if (user_func->profile != NULL) user_func->profile->executions++;
+
+        if (user_func->statement == NULL) {
+            parse_function_body(user_func->definition);
+            optimize_function(user_func->definition);
+            user_func->statement = user_func->definition->func_def_info->statement;
+        }
 
         int64_t param_amt_given = call_node->func_call_info.param_count;
 
@@ -269,22 +371,23 @@ static int64_t call_func(ParseNode* call_node) {
         }
 
         // determine values to pass before creating scope in order to allow users to use parameters in the current scope
-        Vector* params_to_pass = vector_new(1);
+        // the values are stored inline, so calls with few parameters don't allocate
+        Vector params_to_pass;
+        vector_init(&params_to_pass, sizeof(int64_t));
 
         for (int64_t i = 0; i < user_func->param_count; ++i) {
-            int64_t* val = malloc(sizeof(int64_t));
-            *val = visit_node(call_node->func_call_info.params[i]);
-            vector_push(params_to_pass, val);
+            int64_t val = visit_node(call_node->func_call_info.params[i]);
+            vector_append(&params_to_pass, &val);
         }
 
         var_scope_append();
 
         for (int64_t i = 0; i < user_func->param_count; ++i) {
-            int64_t the_value = *(int64_t*)vector_get(params_to_pass, i);
+            int64_t the_value = *(int64_t*)vector_at(&params_to_pass, i);
             var_define_manual(user_func->params[i], the_value, call_node->line);
         }
 
-        vector_free(params_to_pass);
+        vector_deinit(&params_to_pass);
 
         user_function_ret_val = 0;
         visit_node(user_func->statement);
@@ -295,6 +398,7 @@ static int64_t call_func(ParseNode* call_node) {
         return user_function_ret_val;
     }
 
+    HashEntry buffer;
     if (hashtable_get(builtin_functions, &buffer, call_node->func_call_info.name)) {
         int64_t params[call_node->func_call_info.param_count];
 
@@ -319,6 +423,118 @@ static int64_t call_func(ParseNode* call_node) {
     return 0;
 }
 
+static enum KernelOp binop_to_kernel_op(enum BinOpNodeType type) {
+    switch (type) {
+        case BINOP_SUB:
+            return KOP_SUB;
+        case BINOP_BITAND:
+            return KOP_AND;
+        case BINOP_BITOR:
+            return KOP_OR;
+        case BINOP_SHLEFT:
+            return KOP_SHL;
+        case BINOP_SHRIGHT:
+            return KOP_SHR;
+        default:
+            return KOP_ADD;
+    }
+}
+
+static bool in_range(int64_t* ptr, int64_t* start, int64_t count) {
+    return ptr >= start && ptr < start + count;
+}
+
+// the same array, or arrays that don't overlap at all
+static bool arrays_compatible(int64_t* a, int64_t* b, int64_t count) {
+    return a == b || a + count <= b || b + count <= a;
+}
+
+// a variable that the loop would overwrite through memory halfway through
+static bool var_in_range(ParseNode* node, int64_t* start, int64_t count) {
+    if (node->type != N_VARIABLE) return false;
+    return in_range(var_get_addr(node), start, count);
+}
+
+static void profile_vec_loop(NodeProfile* profile, int64_t iterations) {
+    if (profile == NULL) return;
+    profile->executions++;
+    profile->hits += iterations;
+}
+
+// Runs a loop recognised by the optimizer as a native kernel, leaving the variables
+// exactly as the while loop would have.
+// returns: false if the kernel can't be used safely and the fallback has to be interpreted
+static bool run_vec_loop(ParseNode* node) {
+    VecLoopNode* info = node->vec_loop_info;
+
+    int64_t* index_ptr = var_get_addr(info->index);
+    int64_t start = *index_ptr;
+    int64_t limit = visit_node(info->limit);
+
+    NodeProfile* profile = info->fallback->conditional_info.profile;
+    if (start >= limit) {
+        if (profile != NULL) profile->executions++;
+        return true;
+    }
+
+    // keep the byte offsets representable, the interpreter can deal with anything bigger
+    if (start < -(INT64_MAX / 16) || limit > INT64_MAX / 16) return false;
+    int64_t count = limit - start;
+
+    enum KernelOp op = binop_to_kernel_op(info->op);
+
+    if (info->kind == VEC_REDUCE) {
+        int64_t* src = (int64_t*)var_get(info->lhs) + start;
+        int64_t* acc_ptr = var_get_addr(info->dest);
+        if (in_range(acc_ptr, src, count) || in_range(index_ptr, src, count)) return false;
+
+        *acc_ptr = kernel_reduce(op, *acc_ptr, src, count);
+        *index_ptr = limit;
+        profile_vec_loop(profile, count);
+        return true;
+    }
+
+    int64_t* dest = (int64_t*)var_get(info->dest) + start;
+    if (in_range(index_ptr, dest, count)) return false;
+    if (var_in_range(info->limit, dest, count) || var_in_range(info->dest, dest, count)) return false;
+    if (var_in_range(info->lhs, dest, count)) return false;
+    if (info->kind == VEC_BINOP && var_in_range(info->rhs, dest, count)) return false;
+
+    int64_t* lhs_arr = NULL;
+    int64_t* rhs_arr = NULL;
+    if (info->lhs_is_array) {
+        lhs_arr = (int64_t*)var_get(info->lhs) + start;
+        if (!arrays_compatible(dest, lhs_arr, count)) return false;
+    }
+    if (info->kind == VEC_BINOP && info->rhs_is_array) {
+        rhs_arr = (int64_t*)var_get(info->rhs) + start;
+        if (!arrays_compatible(dest, rhs_arr, count)) return false;
+    }
+
+    switch (info->kind) {
+        case VEC_FILL:
+            kernel_fill(dest, visit_node(info->lhs), count);
+            break;
+        case VEC_COPY:
+            kernel_copy(dest, lhs_arr, count);
+            break;
+        case VEC_BINOP:
+            if (lhs_arr != NULL && rhs_arr != NULL)
+                kernel_binop_vv(op, dest, lhs_arr, rhs_arr, count);
+            else if (lhs_arr != NULL)
+                kernel_binop_vs(op, dest, lhs_arr, visit_node(info->rhs), count);
+            else
+                kernel_binop_sv(op, dest, visit_node(info->lhs), rhs_arr, count);
+            break;
+        case VEC_REDUCE:
+            break;
+    }
+
+    *index_ptr = limit;
+    profile_vec_loop(profile, count);
+    return true;
+}
+
 #ifdef DEBUG
 static void debug(int64_t n) {
     (void)n;
@@ -342,13 +558,20 @@ static int64_t visit_node(ParseNode* node) {
         }
         case N_ARR_DEF: {
             int64_t size = visit_node(node->arr_def_info.size);
-            int64_t* ptr = calloc(size, sizeof(int64_t));
-
-            // Put the pointer into the hastable to automatically free it on deletion of the scope
-            // use a '$' because this is not recognized by the tokenizer and can never be a user variable
-            char name[MAX_IDENTIFIER_LENGTH];
-            snprintf(name, MAX_IDENTIFIER_LENGTH, "$arr_%s", node->arr_def_info.name);
-            var_insert_ptr(name, ptr, node->line);
+            if (size < 0 || (uint64_t)size > SIZE_MAX / sizeof(int64_t)) panic("Invalid array size", node->line);
+
+            // large arrays are unmapped with the scope, the others are freed with its table
+            int64_t* ptr = large_array_new(size * sizeof(int64_t));
+            if (ptr == NULL) {
+                ptr = allocator_calloc(var_allocator(), size, sizeof(int64_t));
+                if (ptr == NULL) panic("Out of memory", node->line);
+
+                // Put the pointer into the hastable to automatically free it on deletion of the scope
+                // use a '$' because this is not recognized by the tokenizer and can never be a user variable
+                char name[MAX_IDENTIFIER_LENGTH];
+                snprintf(name, MAX_IDENTIFIER_LENGTH, "$arr_%s", node->arr_def_info.name);
+                var_insert_ptr(name, ptr, node->line);
+            }
 
             // define the array name to point to the array
             var_define_manual(node->arr_def_info.name, (int64_t)ptr, node->line);
@@ -359,6 +582,9 @@ static int64_t visit_node(ParseNode* node) {
             break;
         }
         case N_BIN_OP: {
+            // assignments evaluate their own operands, the left-hand side isn't a value
+            if (node->bin_operation_info.type == BINOP_ASSIGN) return var_set(node);
+
             int64_t left = visit_node(node->bin_operation_info.left);
             int64_t right = visit_node(node->bin_operation_info.right);
 
@@ -420,17 +646,29 @@ static int64_t visit_node(ParseNode* node) {
             return str_get_ptr(node);
         }
         case N_IF: {
+            NodeProfile* profile = node->conditional_info.profile;
             if (visit_node(node->conditional_info.condition)) {
+                if (profile != NULL) profile->hits++;
                 visit_node(node->conditional_info.statement);
             } else if (node->conditional_info.else_statement != NULL) {
                 visit_node(node->conditional_info.else_statement);
             }
+            if (profile != NULL) profile->executions++;
             break;
         }
         case N_WHILE: {
+            NodeProfile* profile = node->conditional_info.profile;
             while (visit_node(node->conditional_info.condition)) {
+                if (profile != NULL) profile->hits++;
                 visit_node(node->conditional_info.statement);
             }
+            if (profile != NULL) profile->executions++;
+            break;
+        }
+        case N_VEC_LOOP: {
+            if (!run_vec_loop(node)) {
+                visit_node(node->vec_loop_info->fallback);
+            }
             break;
         }
         case N_COMPOUND: {
@@ -462,8 +700,11 @@ static int64_t visit_node(ParseNode* node) {
 }
 
 void interpret(ParseNode* node) {
-    global_variables = hashtable_new(ANY_T, MAX_VARIABLE_AMT);
+    global_variables = hashtable_new(ANY_T, INITIAL_VARIABLE_AMT);
+    hashtable_force_free_values(global_variables);
     var_scopes = vector_new(1);  // initial capacity of one, because a program might just be the main function
+    scope_arena = arena_new(SCOPE_ARENA_CHUNK_SIZE);
+    vector_init(&scope_marks, sizeof(ScopeMark));
 
     init_funcs();
     init_strings();
@@ -473,7 +714,10 @@ void interpret(ParseNode* node) {
         panic(buffer, 0);
     }
 
+    // every definition is either a function or a global, so neither table has to grow
     int64_t function_amt = node->root_info.count;
+    hashtable_reserve(user_functions, function_amt);
+    hashtable_reserve(global_variables, function_amt);
     for (int64_t i = 0; i < function_amt; ++i) {
         ParseNode** definitions = node->root_info.definitions;
         visit_node(definitions[i]);
@@ -491,12 +735,16 @@ void interpret(ParseNode* node) {
     main_call.func_call_info.name = "main";
     main_call.func_call_info.param_count = 0;
     call_func(&main_call);
+    output_flush();
+    mapped_file_unmap_all();
+    maps_free_all();
 
 #ifdef DEBUG
     char* var_name;
     HashEntry entry;
+    HashTableIterator iterator = hashtable_iterate(global_variables);
     printf("Global variables:\n");
-    while (hashtable_get_next(global_variables, &entry)) {
+    while (hashtable_iterator_next(&iterator, &entry)) {
         var_name = entry.key;
         int64_t* ptr = (int64_t*)entry.value;
         int64_t val = *ptr;
@@ -506,8 +754,12 @@ void interpret(ParseNode* node) {
 
     hashtable_free(builtin_functions);
     hashtable_free(user_functions);
+    int_hashtable_free(call_targets);
     hashtable_free(global_variables);
+    large_array_release(0);
     free_strings();
 
     vector_free(var_scopes);
+    vector_deinit(&scope_marks);
+    arena_free(scope_arena);
 }
@@ -0,0 +1,431 @@
+#include "kernels.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SSE2_KERNELS
+#endif
+
+// AVX2 isn't part of the baseline x86-64 target, so these kernels are compiled for it one by
+// one and only called once CPUID has shown that the CPU supports it
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#define LOAD256(ptr) _mm256_loadu_si256((const __m256i*)(ptr))
+#define STORE256(ptr, v) _mm256_storeu_si256((__m256i*)(ptr), (v))
+
+static bool has_avx2() {
+    static int supported = -1;
+    if (supported < 0) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx2") != 0;
+    }
+    return supported;
+}
+#endif
+
+#ifdef HAVE_SSE2_KERNELS
+#define LOAD(ptr) _mm_loadu_si128((const __m128i*)(ptr))
+#define STORE(ptr, v) _mm_storeu_si128((__m128i*)(ptr), (v))
+#endif
+
+// runs 'expr' for every remaining element, starting at 'i'
+#define SCALAR_LOOP(expr) \
+    for (; i < n; ++i) {  \
+        dst[i] = (expr);  \
+    }
+
+#ifdef HAVE_AVX2_KERNELS
+AVX2_KERNEL static void fill_avx2(int64_t* dst, int64_t value, int64_t n) {
+    int64_t i = 0;
+    __m256i v = _mm256_set1_epi64x(value);
+    for (; i + 8 <= n; i += 8) {
+        STORE256(dst + i, v);
+        STORE256(dst + i + 4, v);
+    }
+    SCALAR_LOOP(value);
+}
+
+// returns: true if the first 'n' elements of 'a' and 'b' are the same
+AVX2_KERNEL static bool equal_avx2(const int64_t* a, const int64_t* b, int64_t n) {
+    int64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i same0 = _mm256_cmpeq_epi64(LOAD256(a + i), LOAD256(b + i));
+        __m256i same1 = _mm256_cmpeq_epi64(LOAD256(a + i + 4), LOAD256(b + i + 4));
+        if (_mm256_movemask_epi8(_mm256_and_si256(same0, same1)) != -1) return false;
+    }
+    for (; i < n; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+AVX2_KERNEL static int64_t find_avx2(const int64_t* src, int64_t n, int64_t value) {
+    int64_t i = 0;
+    __m256i v = _mm256_set1_epi64x(value);
+    for (; i + 8 <= n; i += 8) {
+        __m256i found0 = _mm256_cmpeq_epi64(LOAD256(src + i), v);
+        __m256i found1 = _mm256_cmpeq_epi64(LOAD256(src + i + 4), v);
+        // one bit per byte, so every element has 8 bits in the mask
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(found0) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(found1) << 32);
+        if (mask != 0) return i + __builtin_ctzll(mask) / 8;
+    }
+    for (; i < n; ++i) {
+        if (src[i] == value) return i;
+    }
+    return -1;
+}
+
+AVX2_KERNEL static int64_t sum_avx2(const int64_t* src, int64_t n) {
+    int64_t i = 0;
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, LOAD256(src + i));
+        acc1 = _mm256_add_epi64(acc1, LOAD256(src + i + 4));
+    }
+    int64_t lanes[4];
+    STORE256(lanes, _mm256_add_epi64(acc0, acc1));
+    int64_t result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; ++i) result += src[i];
+    return result;
+}
+
+// returns: the larger or smaller element of every lane
+AVX2_KERNEL static __m256i pick_avx2(__m256i a, __m256i b, bool max) {
+    __m256i greater = _mm256_cmpgt_epi64(b, a);
+    return max ? _mm256_blendv_epi8(a, b, greater) : _mm256_blendv_epi8(b, a, greater);
+}
+
+// n has to be at least 1
+AVX2_KERNEL static int64_t min_max_avx2(const int64_t* src, int64_t n, bool max) {
+    int64_t i = 0;
+    int64_t result = src[0];
+    if (n >= 8) {
+        // two accumulators, so one comparison doesn't have to wait for the other
+        __m256i acc0 = LOAD256(src);
+        __m256i acc1 = LOAD256(src + 4);
+        for (i = 8; i + 8 <= n; i += 8) {
+            acc0 = pick_avx2(acc0, LOAD256(src + i), max);
+            acc1 = pick_avx2(acc1, LOAD256(src + i + 4), max);
+        }
+        int64_t lanes[4];
+        STORE256(lanes, pick_avx2(acc0, acc1, max));
+        result = lanes[0];
+        for (int64_t lane = 1; lane < 4; ++lane) {
+            if (max ? lanes[lane] > result : lanes[lane] < result) result = lanes[lane];
+        }
+    }
+    for (; i < n; ++i) {
+        if (max ? src[i] > result : src[i] < result) result = src[i];
+    }
+    return result;
+}
+
+// AVX2 only multiplies 32 bit halves, the low 64 bits of a product are
+// lo(a) * lo(b) + ((hi(a) * lo(b) + lo(a) * hi(b)) << 32)
+AVX2_KERNEL static __m256i mul_epi64_avx2(__m256i a, __m256i b) {
+    __m256i low = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+AVX2_KERNEL static int64_t dot_avx2(const int64_t* a, const int64_t* b, int64_t n) {
+    int64_t i = 0;
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, mul_epi64_avx2(LOAD256(a + i), LOAD256(b + i)));
+        acc1 = _mm256_add_epi64(acc1, mul_epi64_avx2(LOAD256(a + i + 4), LOAD256(b + i + 4)));
+    }
+    int64_t lanes[4];
+    STORE256(lanes, _mm256_add_epi64(acc0, acc1));
+    // wraps around like the interpreter's arithmetic
+    uint64_t result = (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; ++i) result += (uint64_t)a[i] * b[i];
+    return result;
+}
+#endif
+
+void kernel_fill(int64_t* dst, int64_t value, int64_t n) {
+#ifdef HAVE_AVX2_KERNELS
+    if (has_avx2()) {
+        fill_avx2(dst, value, n);
+        return;
+    }
+#endif
+
+    int64_t i = 0;
+#ifdef HAVE_SSE2_KERNELS
+    __m128i v = _mm_set1_epi64x(value);
+    for (; i + 4 <= n; i += 4) {
+        STORE(dst + i, v);
+        STORE(dst + i + 2, v);
+    }
+#endif
+    SCALAR_LOOP(value);
+}
+
+void kernel_copy(int64_t* dst, const int64_t* src, int64_t n) {
+    if (dst == src || n <= 0) return;
+    memcpy(dst, src, sizeof(int64_t) * n);
+}
+
+void kernel_move(int64_t* dst, const int64_t* src, int64_t n) {
+    // the C library already picks the widest copy loop the CPU supports
+    if (dst == src || n <= 0) return;
+    memmove(dst, src, sizeof(int64_t) * n);
+}
+
+bool kernel_equal(const int64_t* a, const int64_t* b, int64_t n) {
+    if (a == b || n <= 0) return true;
+#ifdef HAVE_AVX2_KERNELS
+    if (has_avx2()) return equal_avx2(a, b, n);
+#endif
+
+    int64_t i = 0;
+#ifdef HAVE_SSE2_KERNELS
+    // SSE2 can only compare 32 bit lanes, both halves of an element have to match
+    for (; i + 2 <= n; i += 2) {
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(LOAD(a + i), LOAD(b + i))) != 0xFFFF) return false;
+    }
+#endif
+    for (; i < n; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+int64_t kernel_find(const int64_t* src, int64_t n, int64_t value) {
+#ifdef HAVE_AVX2_KERNELS
+    if (has_avx2()) return find_avx2(src, n, value);
+#endif
+
+    for (int64_t i = 0; i < n; ++i) {
+        if (src[i] == value) return i;
+    }
+    return -1;
+}
+
+void kernel_binop_vv(enum KernelOp op, int64_t* dst, const int64_t* a, const int64_t* b, int64_t n) {
+    int64_t i = 0;
+    switch (op) {
+        case KOP_ADD:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_add_epi64(LOAD(a + i), LOAD(b + i)));
+#endif
+            SCALAR_LOOP(a[i] + b[i]);
+            break;
+        case KOP_SUB:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_sub_epi64(LOAD(a + i), LOAD(b + i)));
+#endif
+            SCALAR_LOOP(a[i] - b[i]);
+            break;
+        case KOP_AND:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_and_si128(LOAD(a + i), LOAD(b + i)));
+#endif
+            SCALAR_LOOP(a[i] & b[i]);
+            break;
+        case KOP_OR:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_or_si128(LOAD(a + i), LOAD(b + i)));
+#endif
+            SCALAR_LOOP(a[i] | b[i]);
+            break;
+        // SSE2 has no per-lane 64 bit shifts, these stay scalar
+        case KOP_SHL:
+            SCALAR_LOOP(a[i] << b[i]);
+            break;
+        case KOP_SHR:
+            SCALAR_LOOP(a[i] >> b[i]);
+            break;
+    }
+}
+
+void kernel_binop_vs(enum KernelOp op, int64_t* dst, const int64_t* a, int64_t scalar, int64_t n) {
+    int64_t i = 0;
+#ifdef HAVE_SSE2_KERNELS
+    __m128i s = _mm_set1_epi64x(scalar);
+#endif
+    switch (op) {
+        case KOP_ADD:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_add_epi64(LOAD(a + i), s));
+#endif
+            SCALAR_LOOP(a[i] + scalar);
+            break;
+        case KOP_SUB:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_sub_epi64(LOAD(a + i), s));
+#endif
+            SCALAR_LOOP(a[i] - scalar);
+            break;
+        case KOP_AND:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_and_si128(LOAD(a + i), s));
+#endif
+            SCALAR_LOOP(a[i] & scalar);
+            break;
+        case KOP_OR:
+#ifdef HAVE_SSE2_KERNELS
+            for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_or_si128(LOAD(a + i), s));
+#endif
+            SCALAR_LOOP(a[i] | scalar);
+            break;
+        case KOP_SHL:
+#ifdef HAVE_SSE2_KERNELS
+            // out of range shift amounts are left to the scalar loop to keep its behaviour
+            if (scalar >= 0 && scalar < 64) {
+                __m128i count = _mm_cvtsi64_si128(scalar);
+                for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_sll_epi64(LOAD(a + i), count));
+            }
+#endif
+            SCALAR_LOOP(a[i] << scalar);
+            break;
+        case KOP_SHR:
+            SCALAR_LOOP(a[i] >> scalar);
+            break;
+    }
+}
+
+void kernel_binop_sv(enum KernelOp op, int64_t* dst, int64_t scalar, const int64_t* b, int64_t n) {
+    int64_t i = 0;
+    switch (op) {
+        // commutative operations can reuse the vector-scalar kernels
+        case KOP_ADD:
+        case KOP_AND:
+        case KOP_OR:
+            kernel_binop_vs(op, dst, b, scalar, n);
+            break;
+        case KOP_SUB:
+#ifdef HAVE_SSE2_KERNELS
+            {
+                __m128i s = _mm_set1_epi64x(scalar);
+                for (; i + 2 <= n; i += 2) STORE(dst + i, _mm_sub_epi64(s, LOAD(b + i)));
+            }
+#endif
+            SCALAR_LOOP(scalar - b[i]);
+            break;
+        case KOP_SHL:
+            SCALAR_LOOP(scalar << b[i]);
+            break;
+        case KOP_SHR:
+            SCALAR_LOOP(scalar >> b[i]);
+            break;
+    }
+}
+
+int64_t kernel_reduce(enum KernelOp op, int64_t init, const int64_t* src, int64_t n) {
+    int64_t i = 0;
+    int64_t result = init;
+    switch (op) {
+        case KOP_ADD: {
+#ifdef HAVE_AVX2_KERNELS
+            if (has_avx2()) return init + sum_avx2(src, n);
+#endif
+#ifdef HAVE_SSE2_KERNELS
+            __m128i acc0 = _mm_setzero_si128();
+            __m128i acc1 = _mm_setzero_si128();
+            for (; i + 4 <= n; i += 4) {
+                acc0 = _mm_add_epi64(acc0, LOAD(src + i));
+                acc1 = _mm_add_epi64(acc1, LOAD(src + i + 2));
+            }
+            int64_t lanes[2];
+            STORE(lanes, _mm_add_epi64(acc0, acc1));
+            result += lanes[0] + lanes[1];
+#endif
+            for (; i < n; ++i) result += src[i];
+            break;
+        }
+        case KOP_AND: {
+#ifdef HAVE_SSE2_KERNELS
+            __m128i acc = _mm_set1_epi64x(-1);
+            for (; i + 2 <= n; i += 2) acc = _mm_and_si128(acc, LOAD(src + i));
+            int64_t lanes[2];
+            STORE(lanes, acc);
+            result &= lanes[0] & lanes[1];
+#endif
+            for (; i < n; ++i) result &= src[i];
+            break;
+        }
+        case KOP_OR: {
+#ifdef HAVE_SSE2_KERNELS
+            __m128i acc = _mm_setzero_si128();
+            for (; i + 2 <= n; i += 2) acc = _mm_or_si128(acc, LOAD(src + i));
+            int64_t lanes[2];
+            STORE(lanes, acc);
+            result |= lanes[0] | lanes[1];
+#endif
+            for (; i < n; ++i) result |= src[i];
+            break;
+        }
+        case KOP_SUB:
+            // s - a - b - c == s - (a + b + c)
+            return init - kernel_reduce(KOP_ADD, 0, src, n);
+        case KOP_SHL:
+            for (; i < n; ++i) result = result << src[i];
+            break;
+        case KOP_SHR:
+            for (; i < n; ++i) result = result >> src[i];
+            break;
+    }
+    return result;
+}
+
+// SSE2 can't compare 64 bit lanes, so without AVX2 four independent
+// comparisons per step have to do
+static int64_t min_max_scalar(const int64_t* src, int64_t n, bool max) {
+    int64_t acc[4] = {src[0], src[0], src[0], src[0]};
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (int64_t lane = 0; lane < 4; ++lane) {
+            if (max ? src[i + lane] > acc[lane] : src[i + lane] < acc[lane]) acc[lane] = src[i + lane];
+        }
+    }
+    for (; i < n; ++i) {
+        if (max ? src[i] > acc[0] : src[i] < acc[0]) acc[0] = src[i];
+    }
+    for (int64_t lane = 1; lane < 4; ++lane) {
+        if (max ? acc[lane] > acc[0] : acc[lane] < acc[0]) acc[0] = acc[lane];
+    }
+    return acc[0];
+}
+
+int64_t kernel_min(const int64_t* src, int64_t n) {
+#ifdef HAVE_AVX2_KERNELS
+    if (has_avx2()) return min_max_avx2(src, n, false);
+#endif
+    return min_max_scalar(src, n, false);
+}
+
+int64_t kernel_max(const int64_t* src, int64_t n) {
+#ifdef HAVE_AVX2_KERNELS
+    if (has_avx2()) return min_max_avx2(src, n, true);
+#endif
+    return min_max_scalar(src, n, true);
+}
+
+int64_t kernel_dot(const int64_t* a, const int64_t* b, int64_t n) {
+#ifdef HAVE_AVX2_KERNELS
+    if (has_avx2()) return dot_avx2(a, b, n);
+#endif
+
+    // wraps around like the interpreter's arithmetic
+    uint64_t acc[4] = {0, 0, 0, 0};
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc[0] += (uint64_t)a[i] * b[i];
+        acc[1] += (uint64_t)a[i + 1] * b[i + 1];
+        acc[2] += (uint64_t)a[i + 2] * b[i + 2];
+        acc[3] += (uint64_t)a[i + 3] * b[i + 3];
+    }
+    for (; i < n; ++i) acc[0] += (uint64_t)a[i] * b[i];
+    return acc[0] + acc[1] + acc[2] + acc[3];
+}
@@ -0,0 +1,58 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Native kernels over int64 arrays. These back loops that the optimizer
+// recognised as simple array idioms and the memory builtins. None of them check
+// for overlap between 'dst' and the sources except for exact equality, which is
+// always allowed, and kernel_move. Where the CPU supports AVX2, the kernels that
+// have a version for it pick it at runtime.
+
+enum KernelOp {
+    KOP_ADD,
+    KOP_SUB,
+    KOP_AND,
+    KOP_OR,
+    KOP_SHL,
+    KOP_SHR,
+};
+
+// dst[i] = value
+void kernel_fill(int64_t* dst, int64_t value, int64_t n);
+
+// dst[i] = src[i]
+void kernel_copy(int64_t* dst, const int64_t* src, int64_t n);
+
+// like kernel_copy, but 'dst' and 'src' may overlap
+void kernel_move(int64_t* dst, const int64_t* src, int64_t n);
+
+// returns: true if a[i] == b[i] for every i
+bool kernel_equal(const int64_t* a, const int64_t* b, int64_t n);
+
+// returns: the first i with src[i] == value, or -1
+int64_t kernel_find(const int64_t* src, int64_t n, int64_t value);
+
+// dst[i] = a[i] op b[i]
+void kernel_binop_vv(enum KernelOp op, int64_t* dst, const int64_t* a, const int64_t* b, int64_t n);
+
+// dst[i] = a[i] op scalar
+void kernel_binop_vs(enum KernelOp op, int64_t* dst, const int64_t* a, int64_t scalar, int64_t n);
+
+// dst[i] = scalar op b[i]
+void kernel_binop_sv(enum KernelOp op, int64_t* dst, int64_t scalar, const int64_t* b, int64_t n);
+
+// folds src into init from left to right: ((init op src[0]) op src[1]) ...
+int64_t kernel_reduce(enum KernelOp op, int64_t init, const int64_t* src, int64_t n);
+
+// returns: the smallest element, n has to be at least 1
+int64_t kernel_min(const int64_t* src, int64_t n);
+
+// returns: the largest element, n has to be at least 1
+int64_t kernel_max(const int64_t* src, int64_t n);
+
+// returns: the sum of a[i] * b[i]
+int64_t kernel_dot(const int64_t* a, const int64_t* b, int64_t n);
+
+#endif  // _KERNELS_H
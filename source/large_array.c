@@ -0,0 +1,108 @@
+// for MAP_ANONYMOUS and madvise
+#define _DEFAULT_SOURCE
+
+#include "large_array.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(WINDOWS)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "vector/vector.h"
+
+// smaller arrays are cheaper to take from the scope arena or calloc
+#define LARGE_ARRAY_BYTES (1024 * 1024)
+
+// larger arrays are put on huge pages, each of which wastes up to a page at the end
+#define HUGE_PAGE_ARRAY_BYTES (4 * 1024 * 1024)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct LargeArray {
+    void* pointer;
+    size_t bytes;
+} LargeArray;
+
+static Vector arrays;
+static bool initialized = false;
+
+#if defined(WINDOWS)
+
+static void* map_pages(size_t bytes) {
+    // large pages need a privilege most users don't have, so these stay on normal pages
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void unmap_pages(void* pointer, size_t bytes) {
+    (void)bytes;
+    VirtualFree(pointer, 0, MEM_RELEASE);
+}
+
+#else  // linux
+
+static void* map_pages(size_t bytes) {
+    bool huge = bytes >= HUGE_PAGE_ARRAY_BYTES;
+    if (huge && bytes > SIZE_MAX - HUGE_PAGE_SIZE) return NULL;
+
+    // huge pages have to start at a multiple of their size, so a bit more is mapped and the
+    // unaligned ends are cut off again
+    size_t mapped = huge ? bytes + HUGE_PAGE_SIZE : bytes;
+    char* pointer = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pointer == MAP_FAILED) return NULL;
+    if (!huge) return pointer;
+
+    char* start = (char*)(((uintptr_t)pointer + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (start > pointer) munmap(pointer, start - pointer);
+    size_t tail = (pointer + mapped) - (start + bytes);
+    if (tail > 0) munmap(start + bytes, tail);
+
+#ifdef MADV_HUGEPAGE
+    // only a request, without transparent huge pages the array just stays on normal pages
+    madvise(start, bytes, MADV_HUGEPAGE);
+#endif
+    return start;
+}
+
+static void unmap_pages(void* pointer, size_t bytes) {
+    munmap(pointer, bytes);
+}
+
+#endif
+
+int64_t* large_array_new(size_t bytes) {
+    if (bytes < LARGE_ARRAY_BYTES) return NULL;
+
+    if (!initialized) {
+        vector_init(&arrays, sizeof(LargeArray));
+        initialized = true;
+    }
+
+    LargeArray array = {map_pages(bytes), bytes};
+    if (array.pointer == NULL) return NULL;
+
+    vector_append(&arrays, &array);
+    return array.pointer;
+}
+
+size_t large_array_mark() {
+    return initialized ? vector_size(&arrays) : 0;
+}
+
+void large_array_release(size_t mark) {
+    if (!initialized) return;
+
+    LargeArray array;
+    while (vector_size(&arrays) > mark) {
+        vector_pop(&arrays, &array);
+        unmap_pages(array.pointer, array.bytes);
+    }
+
+    // nothing is left once the global arrays are gone
+    if (mark == 0) {
+        vector_deinit(&arrays);
+        initialized = false;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef _LARGE_ARRAY_H
+#define _LARGE_ARRAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Storage for arrays too large for the scope arena. They get pages of their own straight from
+// the system, which come zeroed and are only backed by memory once they are touched, so large
+// arrays cost nothing up front. The largest ones are put on huge pages where the system
+// supports it, which takes far fewer TLB entries when walking them.
+// Arrays are released in the reverse order they were created, like scopes.
+
+// returns: zeroed memory for an array of 'bytes', or NULL if it is small enough for a normal
+// allocation or the pages couldn't be mapped
+int64_t* large_array_new(size_t bytes);
+
+// returns: a point to go back to with large_array_release
+size_t large_array_mark();
+
+// unmaps every array created after 'mark' was taken
+void large_array_release(size_t mark);
+
+#endif  // _LARGE_ARRAY_H
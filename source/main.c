@@ -2,9 +2,18 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include "ast_cache.h"
+#include "heap.h"
+#include "input.h"
 #include "interpreter.h"
+#include "optimizer.h"
+#include "output.h"
+#include "parallel_parse.h"
 #include "parser.h"
+#include "profile.h"
 #include "tokenizer.h"
 
 void read_file(FILE* file, size_t n, char* buffer) {
@@ -24,17 +33,82 @@ size_t get_file_size(FILE* file) {
     return size;
 }
 
+double get_seconds() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) {
+    char* path = NULL;
+    bool print_optimizer_summary = false;
+    char* profile_in = NULL;
+    char* profile_out = NULL;
+    bool use_cache = false;
+    char* cache_dir = NULL;
+    bool lazy = false;
+    int64_t parse_threads = 1;
+    bool print_times = false;
+    bool unbuffered = false;
+    bool batch_input = false;
+    bool heap_stats = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--opt-summary") == 0) {
+            print_optimizer_summary = true;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            use_cache = true;
+        } else if (strcmp(argv[i], "--time") == 0) {
+            print_times = true;
+        } else if (strcmp(argv[i], "--lazy") == 0) {
+            lazy = true;
+        } else if (strcmp(argv[i], "--unbuffered") == 0) {
+            unbuffered = true;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch_input = true;
+        } else if (strcmp(argv[i], "--heap-stats") == 0) {
+            heap_stats = true;
+        } else if (strcmp(argv[i], "--profile-in") == 0 || strcmp(argv[i], "--profile-out") == 0 || strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Option \"%s\" expects a path\n", argv[i]);
+                exit(1);
+            }
+            if (strcmp(argv[i], "--profile-in") == 0) {
+                profile_in = argv[++i];
+            } else if (strcmp(argv[i], "--profile-out") == 0) {
+                profile_out = argv[++i];
+            } else {
+                use_cache = true;
+                cache_dir = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--parse-threads") == 0) {
+            char* end = NULL;
+            if (i + 1 < argc) parse_threads = strtol(argv[++i], &end, 10);
+            if (end == NULL || *end != '\0' || parse_threads < 1) {
+                fprintf(stderr, "Option \"--parse-threads\" expects a positive number\n");
+                exit(1);
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Unknown option \"%s\"\n", argv[i]);
+            exit(1);
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Please specify only one file\n");
+            exit(1);
+        }
+    }
+
+    if (path == NULL) {
         fprintf(stderr, "Please specify file\n");
         exit(1);
     }
 
     // reading file:
-    FILE* file = fopen(argv[1], "r");
+    FILE* file = fopen(path, "r");
 
     if (file == NULL) {
-        fprintf(stderr, "Could not open file \"%s\"\n", argv[1]);
+        fprintf(stderr, "Could not open file \"%s\"\n", path);
         exit(1);
     }
 
@@ -45,21 +119,78 @@ int main(int argc, char** argv) {
 
     fclose(file);
 
-    // Tokenizing file:
-    TokenLL* tokens;
+    // a profile changes what the optimizer does, so a tree optimized with one can't be reused
+    char* cache_path = NULL;
+    if (use_cache && profile_in == NULL) {
+        cache_path = ast_cache_path(path, cache_dir);
+    }
 
-    tokenize(buffer, &tokens);
+    // caching and profiling need every body, so they win over lazy parsing
+    if (use_cache || profile_in != NULL || profile_out != NULL) {
+        lazy = false;
+    }
 
-    free(buffer);
+    double front_end_start = get_seconds();
+
+    ParseNode* tree = NULL;
+    TokenLL* tokens = NULL;
+    // the optimizer summary is only printed while optimizing, so the cache is written but not read
+    if (cache_path != NULL && !print_optimizer_summary) {
+        tree = ast_cache_load(cache_path, buffer, file_size);
+    }
+    bool from_cache = tree != NULL;
+
+    if (!from_cache) {
+        if (parse_threads > 1) {
+            // Tokenizing and parsing chunks of the file on several threads:
+            tree = parse_parallel(buffer, file_size, parse_threads, lazy, &tokens);
 
 #ifdef DEBUG
-    print_tokens(tokens->head);
+            print_tokens(tokens->head);
 #endif
+        } else {
+            // Tokenizing file:
+            tokenize(buffer, &tokens);
 
-    // Parsing tokens:
-    ParseNode* tree = parse(tokens);
+#ifdef DEBUG
+            print_tokens(tokens->head);
+#endif
 
-    free_token(tokens->head);
+            // Parsing tokens:
+            tree = parse(tokens, lazy);
+        }
+
+        // skipped function bodies are parsed from the tokens when they are first called
+        if (!lazy) {
+            free_token(tokens->head);
+            free(tokens);
+            tokens = NULL;
+        }
+
+        if (profile_in != NULL && !profile_load(profile_in)) {
+            fprintf(stderr, "Could not load profile \"%s\", continuing without it\n", profile_in);
+        }
+    }
+
+    double front_end_end = get_seconds();
+
+    if (profile_in != NULL || profile_out != NULL) {
+        profile_attach(tree);
+    }
+
+    double optimizer_start = get_seconds();
+    if (!from_cache) {
+        optimize_AST(tree, print_optimizer_summary);
+
+        if (cache_path != NULL && !ast_cache_save(cache_path, tree, buffer, file_size)) {
+            fprintf(stderr, "Could not write cache file \"%s\"\n", cache_path);
+        }
+    }
+
+    double optimizer_end = get_seconds();
+
+    free(cache_path);
+    free(buffer);
 
 #ifdef DEBUG
     print_AST(tree, 0);
@@ -69,9 +200,36 @@ int main(int argc, char** argv) {
 #ifdef DEBUG
     printf("Program output:\n");
 #endif
+    output_init(unbuffered);
+    input_init(batch_input);
+    heap_init(heap_stats);
+    double interpreter_start = get_seconds();
     interpret(tree);
+    double interpreter_end = get_seconds();
+    heap_finish();
+
+    if (print_times) {
+        double front_end = front_end_end - front_end_start;
+        fprintf(stderr, "front end:   %10.3f ms, %.1f MB/s%s\n", front_end * 1e3,
+                file_size / front_end / 1e6, from_cache ? " (from cache)" : "");
+        fprintf(stderr, "optimizer:   %10.3f ms\n", (optimizer_end - optimizer_start) * 1e3);
+        fprintf(stderr, "interpreter: %10.3f ms\n", (interpreter_end - interpreter_start) * 1e3);
+    }
 
-    free_AST(tree);
+    if (profile_out != NULL && !profile_write(profile_out)) {
+        fprintf(stderr, "Could not write profile \"%s\"\n", profile_out);
+    }
+    profile_free();
+
+    if (from_cache)
+        ast_cache_release(tree);
+    else
+        free_AST(tree);
+
+    if (tokens != NULL) {
+        free_token(tokens->head);
+        free(tokens);
+    }
 
     return 0;
 }
@@ -0,0 +1,122 @@
+// for mmap, open and stat
+#define _POSIX_C_SOURCE 200809L
+
+#include "mapped_file.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "hashtable/hashtable.h"
+
+// start of every mapping -> its length in bytes
+static IntHashTable* mappings = NULL;
+
+static void remember(void* pointer, int64_t length) {
+    if (mappings == NULL) mappings = int_hashtable_new(8);
+    int_hashtable_set(mappings, (intptr_t)pointer, length);
+}
+
+#if defined(WINDOWS)
+
+void* mapped_file_map(const char* path, bool writable) {
+    HANDLE file = CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // the view keeps the file open, the handles aren't needed after mapping it
+    HANDLE mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return NULL;
+
+    void* result = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (result == NULL) return NULL;
+
+    remember(result, size.QuadPart);
+    return result;
+}
+
+static void unmap(void* pointer, int64_t length) {
+    (void)length;
+    UnmapViewOfFile(pointer);
+}
+
+int64_t mapped_file_size(const char* path) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) return -1;
+
+    return ((int64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+}
+
+#else  // linux
+
+void* mapped_file_map(const char* path, bool writable) {
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // the mapping keeps the file open, the descriptor isn't needed after mapping it
+    void* result = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (result == MAP_FAILED) return NULL;
+
+    remember(result, info.st_size);
+    return result;
+}
+
+static void unmap(void* pointer, int64_t length) {
+    munmap(pointer, length);
+}
+
+int64_t mapped_file_size(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0) return -1;
+
+    return info.st_size;
+}
+
+#endif
+
+bool mapped_file_unmap(void* pointer) {
+    int64_t length;
+    if (mappings == NULL || !int_hashtable_get(mappings, &length, (intptr_t)pointer)) return false;
+
+    unmap(pointer, length);
+    int_hashtable_delete(mappings, (intptr_t)pointer);
+    return true;
+}
+
+void mapped_file_unmap_all() {
+    if (mappings == NULL) return;
+
+    int64_t pointer;
+    int64_t length;
+    IntHashTableIterator iterator = int_hashtable_iterate(mappings);
+    while (int_hashtable_iterator_next(&iterator, &pointer, &length)) {
+        unmap((void*)(intptr_t)pointer, length);
+    }
+
+    int_hashtable_free(mappings);
+    mappings = NULL;
+}
@@ -0,0 +1,25 @@
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Files mapped into memory, so programs can walk them with plain pointers instead of copying
+// them into arrays first. Every mapping is remembered until it is unmapped, so pointers that
+// didn't come from mapped_file_map can be told apart.
+
+// writable: changes are written back to the file. Otherwise the mapping is a private
+// copy-on-write view, changes only stay in memory
+// returns: the start of the mapping, or NULL if the file can't be mapped or is empty
+void* mapped_file_map(const char* path, bool writable);
+
+// returns: false if 'pointer' isn't the start of a mapping
+bool mapped_file_unmap(void* pointer);
+
+// returns: size of the file in bytes, or -1 if it doesn't exist
+int64_t mapped_file_size(const char* path);
+
+// unmaps everything that is still mapped, writing changes back
+void mapped_file_unmap_all();
+
+#endif  // _MAPPED_FILE_H
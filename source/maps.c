@@ -0,0 +1,63 @@
+#include "maps.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hashtable/hashtable.h"
+#include "vector/vector.h"
+
+#define INITIAL_MAP_SIZE 16
+
+// handle - 1 -> map, NULL once freed
+static Vector maps;
+// indices of freed maps, to be reused
+static Vector free_indices;
+static bool initialized = false;
+
+int64_t maps_new() {
+    if (!initialized) {
+        vector_init(&maps, sizeof(IntHashTable*));
+        vector_init(&free_indices, sizeof(size_t));
+        initialized = true;
+    }
+
+    IntHashTable* map = int_hashtable_new(INITIAL_MAP_SIZE);
+    size_t index;
+    if (vector_pop(&free_indices, &index)) {
+        *(IntHashTable**)vector_at(&maps, index) = map;
+    } else {
+        index = vector_size(&maps);
+        vector_append(&maps, &map);
+    }
+    return index + 1;
+}
+
+IntHashTable* maps_get(int64_t handle) {
+    if (!initialized || handle < 1 || (uint64_t)handle > vector_size(&maps)) return NULL;
+
+    return *(IntHashTable**)vector_at(&maps, handle - 1);
+}
+
+bool maps_free(int64_t handle) {
+    IntHashTable* map = maps_get(handle);
+    if (map == NULL) return false;
+
+    int_hashtable_free(map);
+    *(IntHashTable**)vector_at(&maps, handle - 1) = NULL;
+    size_t index = handle - 1;
+    vector_append(&free_indices, &index);
+    return true;
+}
+
+void maps_free_all() {
+    if (!initialized) return;
+
+    for (size_t i = 0; i < vector_size(&maps); ++i) {
+        IntHashTable* map = *(IntHashTable**)vector_at(&maps, i);
+        if (map != NULL) int_hashtable_free(map);
+    }
+    vector_deinit(&maps);
+    vector_deinit(&free_indices);
+    initialized = false;
+}
@@ -0,0 +1,25 @@
+#ifndef _MAPS_H
+#define _MAPS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hashtable/hashtable.h"
+
+// Hash maps of the interpreted program. Programs only see a handle for every map, a small
+// number that is checked on every use, so a wrong number can't be taken for a map.
+// Handles of freed maps are given out again.
+
+// returns: the handle of a new, empty map, never 0
+int64_t maps_new();
+
+// returns: the map, or NULL if 'handle' doesn't belong to one
+IntHashTable* maps_get(int64_t handle);
+
+// returns: false if 'handle' doesn't belong to a map
+bool maps_free(int64_t handle);
+
+// frees every map that is still there
+void maps_free_all();
+
+#endif  // _MAPS_H
@@ -0,0 +1,689 @@
+#include "optimizer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "profile.h"
+#include "vector/vector.h"
+#include "xplatform.h"
+
+// loops that ran fewer iterations than this on average in a profiled run aren't worth the
+// lookups and overlap checks the kernel does up front
+#define MIN_PROFILED_TRIP_COUNT 4
+
+static bool is_variable(ParseNode* node, char* name) {
+    return node->type == N_VARIABLE && strcmp(node->variable_info.name, name) == 0;
+}
+
+static bool is_number_node(ParseNode* node, int64_t value) {
+    return node->type == N_NUMBER && node->number_info.value == value;
+}
+
+// matches "arr[index]", which the parser expands to "@(arr + index * 8)"
+// returns: the N_VARIABLE node of the array, or NULL if it doesn't match
+static ParseNode* match_element(ParseNode* node, char* index) {
+    if (node->type != N_UN_OP || node->un_operation_info.type != UNOP_DEREF) return NULL;
+
+    ParseNode* addr = node->un_operation_info.operand;
+    if (addr->type != N_BIN_OP || addr->bin_operation_info.type != BINOP_ADD) return NULL;
+
+    ParseNode* arr = addr->bin_operation_info.left;
+    ParseNode* offset = addr->bin_operation_info.right;
+    if (arr->type != N_VARIABLE || is_variable(arr, index)) return NULL;
+    if (offset->type != N_BIN_OP || offset->bin_operation_info.type != BINOP_MUL) return NULL;
+    if (!is_variable(offset->bin_operation_info.left, index)) return NULL;
+    if (!is_number_node(offset->bin_operation_info.right, 8)) return NULL;
+
+    return arr;
+}
+
+// a value that can't change while the loop runs, apart from through memory writes,
+// which the interpreter checks for before running the kernel
+static bool is_invariant(ParseNode* node, char* index, char* written) {
+    if (node->type == N_NUMBER) return true;
+    if (node->type != N_VARIABLE) return false;
+    if (is_variable(node, index)) return false;
+    if (written != NULL && is_variable(node, written)) return false;
+    return true;
+}
+
+static bool is_elementwise_op(enum BinOpNodeType type) {
+    switch (type) {
+        case BINOP_ADD:
+        case BINOP_SUB:
+        case BINOP_BITAND:
+        case BINOP_BITOR:
+        case BINOP_SHLEFT:
+        case BINOP_SHRIGHT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_commutative_op(enum BinOpNodeType type) {
+    return type == BINOP_ADD || type == BINOP_BITAND || type == BINOP_BITOR;
+}
+
+// matches one side of an element-wise operation, either "arr[index]" or an invariant value
+static bool match_operand(ParseNode* node, char* index, ParseNode** result, bool* is_array) {
+    ParseNode* arr = match_element(node, index);
+    if (arr != NULL) {
+        *result = arr;
+        *is_array = true;
+        return true;
+    }
+
+    if (is_invariant(node, index, NULL)) {
+        *result = node;
+        *is_array = false;
+        return true;
+    }
+
+    return false;
+}
+
+// matches "dest[index] = ..."
+static bool match_elementwise(ParseNode* assign, char* index, VecLoopNode* info) {
+    info->dest = match_element(assign->bin_operation_info.left, index);
+    if (info->dest == NULL) return false;
+
+    ParseNode* value = assign->bin_operation_info.right;
+
+    ParseNode* src = match_element(value, index);
+    if (src != NULL) {
+        info->kind = VEC_COPY;
+        info->lhs = src;
+        info->lhs_is_array = true;
+        return true;
+    }
+
+    if (is_invariant(value, index, NULL)) {
+        info->kind = VEC_FILL;
+        info->lhs = value;
+        return true;
+    }
+
+    if (value->type != N_BIN_OP || !is_elementwise_op(value->bin_operation_info.type)) return false;
+
+    if (!match_operand(value->bin_operation_info.left, index, &info->lhs, &info->lhs_is_array)) return false;
+    if (!match_operand(value->bin_operation_info.right, index, &info->rhs, &info->rhs_is_array)) return false;
+
+    // "dest[i] = x + y" is a fill, but not worth a kernel of its own
+    if (!info->lhs_is_array && !info->rhs_is_array) return false;
+
+    info->kind = VEC_BINOP;
+    info->op = value->bin_operation_info.type;
+    return true;
+}
+
+// matches "acc = acc op arr[index]", or "acc = arr[index] op acc" for commutative operations
+static bool match_reduction(ParseNode* assign, char* index, VecLoopNode* info) {
+    ParseNode* acc = assign->bin_operation_info.left;
+    if (acc->type != N_VARIABLE || is_variable(acc, index)) return false;
+
+    ParseNode* value = assign->bin_operation_info.right;
+    if (value->type != N_BIN_OP || !is_elementwise_op(value->bin_operation_info.type)) return false;
+
+    char* acc_name = acc->variable_info.name;
+    ParseNode* left = value->bin_operation_info.left;
+    ParseNode* right = value->bin_operation_info.right;
+
+    ParseNode* src = NULL;
+    if (is_variable(left, acc_name)) {
+        src = match_element(right, index);
+    } else if (is_variable(right, acc_name) && is_commutative_op(value->bin_operation_info.type)) {
+        src = match_element(left, index);
+    }
+
+    // "acc = acc + acc[i]" changes the array pointer while the loop runs
+    if (src == NULL || is_variable(src, acc_name)) return false;
+
+    info->kind = VEC_REDUCE;
+    info->op = value->bin_operation_info.type;
+    info->dest = acc;
+    info->lhs = src;
+    info->lhs_is_array = true;
+    return true;
+}
+
+// matches "while (index < limit) { <statement>; index = index + 1; }"
+static bool match_vec_loop(ParseNode* loop, VecLoopNode* info) {
+    ParseNode* condition = loop->conditional_info.condition;
+    if (condition->type != N_BIN_OP || condition->bin_operation_info.type != BINOP_LESS) return false;
+    if (condition->bin_operation_info.left->type != N_VARIABLE) return false;
+
+    info->index = condition->bin_operation_info.left;
+    char* index = info->index->variable_info.name;
+
+    ParseNode* body = loop->conditional_info.statement;
+    if (body->type != N_COMPOUND || body->compound_info.statement_amt != 2) return false;
+
+    ParseNode* increment = body->compound_info.statements[1];
+    if (increment->type != N_BIN_OP || increment->bin_operation_info.type != BINOP_ASSIGN) return false;
+    if (!is_variable(increment->bin_operation_info.left, index)) return false;
+
+    ParseNode* step = increment->bin_operation_info.right;
+    if (step->type != N_BIN_OP || step->bin_operation_info.type != BINOP_ADD) return false;
+    if (!is_variable(step->bin_operation_info.left, index) || !is_number_node(step->bin_operation_info.right, 1)) return false;
+
+    ParseNode* statement = body->compound_info.statements[0];
+    if (statement->type != N_BIN_OP || statement->bin_operation_info.type != BINOP_ASSIGN) return false;
+
+    if (!match_elementwise(statement, index, info) && !match_reduction(statement, index, info)) return false;
+
+    // the limit is re-evaluated every iteration, so it can't be something the loop writes to
+    info->limit = condition->bin_operation_info.right;
+    char* written = info->kind == VEC_REDUCE ? info->dest->variable_info.name : NULL;
+    return is_invariant(info->limit, index, written);
+}
+
+static void vectorize_loops(ParseNode* node) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case N_ROOT:
+            for (int64_t i = 0; i < node->root_info.count; ++i) {
+                vectorize_loops(node->root_info.definitions[i]);
+            }
+            break;
+        case N_FUNC_DEF:
+            vectorize_loops(node->func_def_info->statement);
+            break;
+        case N_IF:
+            vectorize_loops(node->conditional_info.statement);
+            vectorize_loops(node->conditional_info.else_statement);
+            break;
+        case N_WHILE: {
+            vectorize_loops(node->conditional_info.statement);
+
+            NodeProfile* profile = node->conditional_info.profile;
+            if (profile != NULL && profile->executions > 0 && profile->hits / profile->executions < MIN_PROFILED_TRIP_COUNT) break;
+
+            VecLoopNode info = {0};
+            if (!match_vec_loop(node, &info)) break;
+
+            // rewrite in place so the parent doesn't have to be updated
+            ParseNode* fallback = malloc(sizeof(ParseNode));
+            *fallback = *node;
+
+            info.fallback = fallback;
+            node->type = N_VEC_LOOP;
+            node->vec_loop_info = malloc(sizeof(VecLoopNode));
+            *node->vec_loop_info = info;
+            break;
+        }
+        case N_COMPOUND:
+            for (size_t i = 0; i < node->compound_info.statement_amt; ++i) {
+                vectorize_loops(node->compound_info.statements[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// ----- dead function elimination -----
+
+static int compare_func_names(const void* a, const void* b) {
+    ParseNode* const* left = a;
+    ParseNode* const* right = b;
+    return strcmp((*left)->func_def_info->name, (*right)->func_def_info->name);
+}
+
+// returns: index of the first function called 'name' in the sorted 'funcs', or -1
+static int64_t find_func(ParseNode** funcs, int64_t count, char* name) {
+    int64_t low = 0;
+    int64_t high = count;
+    while (low < high) {
+        int64_t mid = low + (high - low) / 2;
+        if (strcmp(funcs[mid]->func_def_info->name, name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low < count && strcmp(funcs[low]->func_def_info->name, name) == 0) return low;
+    return -1;
+}
+
+static void collect_calls(ParseNode* node, Vector* calls) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case N_FUNC_CALL:
+            vector_push(calls, node->func_call_info.name);
+            for (int64_t i = 0; i < node->func_call_info.param_count; ++i) {
+                collect_calls(node->func_call_info.params[i], calls);
+            }
+            break;
+        case N_FUNC_DEF:
+            collect_calls(node->func_def_info->statement, calls);
+            break;
+        case N_VAR_DEF:
+            collect_calls(node->var_def_info.initial_val, calls);
+            break;
+        case N_ARR_DEF:
+            collect_calls(node->arr_def_info.size, calls);
+            break;
+        case N_BIN_OP:
+            collect_calls(node->bin_operation_info.left, calls);
+            collect_calls(node->bin_operation_info.right, calls);
+            break;
+        case N_UN_OP:
+            collect_calls(node->un_operation_info.operand, calls);
+            break;
+        case N_IF:
+        case N_WHILE:
+            collect_calls(node->conditional_info.condition, calls);
+            collect_calls(node->conditional_info.statement, calls);
+            collect_calls(node->conditional_info.else_statement, calls);
+            break;
+        case N_COMPOUND:
+            for (size_t i = 0; i < node->compound_info.statement_amt; ++i) {
+                collect_calls(node->compound_info.statements[i], calls);
+            }
+            break;
+        case N_RETURN:
+            collect_calls(node->return_info.value, calls);
+            break;
+        case N_VEC_LOOP:
+            collect_calls(node->vec_loop_info->fallback, calls);
+            break;
+        default:
+            break;
+    }
+}
+
+// Drops every function that can't be reached from main or from a global variable initialiser.
+// returns: the amount of functions removed
+static int64_t remove_dead_functions(ParseNode* root, bool print_summary) {
+    int64_t count = root->root_info.count;
+    ParseNode** definitions = root->root_info.definitions;
+
+    ParseNode** funcs = malloc(sizeof(ParseNode*) * (count + 1));
+    int64_t func_amt = 0;
+    for (int64_t i = 0; i < count; ++i) {
+        if (definitions[i]->type == N_FUNC_DEF) funcs[func_amt++] = definitions[i];
+    }
+    qsort(funcs, func_amt, sizeof(ParseNode*), compare_func_names);
+
+    // without a main function the interpreter will complain, leave everything alone
+    if (find_func(funcs, func_amt, "main") < 0) {
+        free(funcs);
+        return 0;
+    }
+
+    bool* reached = calloc(func_amt + 1, sizeof(bool));
+
+    Vector worklist;
+    vector_init(&worklist, sizeof(char*));
+    vector_push(&worklist, "main");
+    for (int64_t i = 0; i < count; ++i) {
+        if (definitions[i]->type != N_FUNC_DEF) collect_calls(definitions[i], &worklist);
+    }
+
+    void* next;
+    while (vector_pop(&worklist, &next)) {
+        int64_t idx = find_func(funcs, func_amt, (char*)next);
+        if (idx < 0 || reached[idx]) continue;  // builtin, unknown or already visited
+
+        // a function may be defined more than once, keep all of them
+        for (; idx < func_amt && strcmp(funcs[idx]->func_def_info->name, (char*)next) == 0; ++idx) {
+            reached[idx] = true;
+            collect_calls(funcs[idx], &worklist);
+        }
+    }
+    vector_deinit(&worklist);
+
+    // look everything up before anything gets freed, the lookup reads the other definitions
+    bool* keep = malloc(sizeof(bool) * (count + 1));
+    for (int64_t i = 0; i < count; ++i) {
+        ParseNode* definition = definitions[i];
+        keep[i] = definition->type != N_FUNC_DEF || reached[find_func(funcs, func_amt, definition->func_def_info->name)];
+    }
+
+    // compact the definitions, keeping their order
+    int64_t kept = 0;
+    for (int64_t i = 0; i < count; ++i) {
+        ParseNode* definition = definitions[i];
+        if (!keep[i]) {
+            if (print_summary)
+                fprintf(stderr, "Removed unused function '%s' (line " INT64_FORMAT ")\n", definition->func_def_info->name, (int64_t)definition->line);
+            free_AST(definition);
+            continue;
+        }
+        definitions[kept++] = definition;
+    }
+    root->root_info.count = kept;
+
+    free(keep);
+    free(reached);
+    free(funcs);
+
+    return count - kept;
+}
+
+// ----- profile guided function ordering -----
+
+typedef struct RankedFunc {
+    ParseNode* func_def;
+    int64_t calls;
+    int64_t position;
+} RankedFunc;
+
+static int compare_ranked_funcs(const void* a, const void* b) {
+    const RankedFunc* left = a;
+    const RankedFunc* right = b;
+    if (left->calls != right->calls) return left->calls > right->calls ? -1 : 1;
+    return left->position < right->position ? -1 : 1;
+}
+
+// Defines the most called functions of a profiled run first, so they end up in their own
+// slot of the function table and are found without probing.
+static void order_functions_by_profile(ParseNode* root) {
+    int64_t count = root->root_info.count;
+    ParseNode** definitions = root->root_info.definitions;
+
+    // a global initialiser can only call functions defined above it, reordering would change that
+    Vector calls;
+    vector_init(&calls, sizeof(char*));
+    for (int64_t i = 0; i < count; ++i) {
+        if (definitions[i]->type != N_FUNC_DEF) collect_calls(definitions[i], &calls);
+    }
+    bool has_global_calls = vector_size(&calls) > 0;
+    vector_deinit(&calls);
+    if (has_global_calls) return;
+
+    RankedFunc* funcs = malloc(sizeof(RankedFunc) * (count + 1));
+    int64_t func_amt = 0;
+    bool profiled = false;
+    for (int64_t i = 0; i < count; ++i) {
+        if (definitions[i]->type != N_FUNC_DEF) continue;
+
+        NodeProfile* profile = definitions[i]->func_def_info->profile;
+        funcs[func_amt].func_def = definitions[i];
+        funcs[func_amt].calls = profile == NULL ? 0 : profile->executions;
+        funcs[func_amt].position = func_amt;
+        if (funcs[func_amt].calls > 0) profiled = true;
+        ++func_amt;
+    }
+
+    // which one of a function defined twice wins depends on the order, leave those alone
+    bool has_duplicates = false;
+    ParseNode** by_name = malloc(sizeof(ParseNode*) * (func_amt + 1));
+    for (int64_t i = 0; i < func_amt; ++i) {
+        by_name[i] = funcs[i].func_def;
+    }
+    qsort(by_name, func_amt, sizeof(ParseNode*), compare_func_names);
+    for (int64_t i = 1; i < func_amt && !has_duplicates; ++i) {
+        has_duplicates = compare_func_names(&by_name[i - 1], &by_name[i]) == 0;
+    }
+    free(by_name);
+
+    if (profiled && !has_duplicates) {
+        qsort(funcs, func_amt, sizeof(RankedFunc), compare_ranked_funcs);
+
+        int64_t next = 0;
+        for (int64_t i = 0; i < count; ++i) {
+            if (definitions[i]->type == N_FUNC_DEF) definitions[i] = funcs[next++].func_def;
+        }
+    }
+
+    free(funcs);
+}
+
+// ----- dead store elimination -----
+
+typedef struct LocalInfo {
+    char* name;
+    int64_t reads;
+    int64_t defs;
+    int64_t def_position;    // index of the defining statement in the function body, -1 for parameters
+    int64_t first_store;     // index of the top level statement holding the first store
+    bool eligible;           // cleared when anything makes removing its stores unsafe
+} LocalInfo;
+
+static LocalInfo* get_local(Vector* locals, char* name) {
+    for (size_t i = 0; i < vector_size(locals); ++i) {
+        LocalInfo* info = vector_get(locals, i);
+        if (strcmp(info->name, name) == 0) return info;
+    }
+
+    // copy the name, the node it comes from might get removed
+    LocalInfo* info = malloc(sizeof(LocalInfo));
+    info->name = malloc(sizeof(char) * (strlen(name) + 1));
+    strcpy(info->name, name);
+    info->reads = 0;
+    info->defs = 0;
+    info->def_position = INT64_MAX;
+    info->first_store = INT64_MAX;
+    info->eligible = true;
+    vector_push(locals, info);
+    return info;
+}
+
+// 'position' is the index of the top level statement in the function body that contains 'node'
+static void scan_locals(ParseNode* node, Vector* locals, int64_t position, bool is_statement, bool top_level) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case N_VARIABLE:
+            get_local(locals, node->variable_info.name)->reads++;
+            break;
+        case N_VAR_DEF: {
+            LocalInfo* info = get_local(locals, node->var_def_info.name);
+            info->defs++;
+            info->def_position = position;
+            // a definition that is conditional or inside a loop is too hard to reason about
+            if (!top_level) info->eligible = false;
+            scan_locals(node->var_def_info.initial_val, locals, position, false, false);
+            break;
+        }
+        case N_ARR_DEF: {
+            LocalInfo* info = get_local(locals, node->arr_def_info.name);
+            info->defs++;
+            info->eligible = false;
+            scan_locals(node->arr_def_info.size, locals, position, false, false);
+            break;
+        }
+        case N_BIN_OP:
+            if (node->bin_operation_info.type == BINOP_ASSIGN && node->bin_operation_info.left->type == N_VARIABLE) {
+                LocalInfo* info = get_local(locals, node->bin_operation_info.left->variable_info.name);
+                if (position < info->first_store) info->first_store = position;
+                // the value of the assignment is used by the surrounding expression
+                if (!is_statement) info->eligible = false;
+            } else {
+                scan_locals(node->bin_operation_info.left, locals, position, false, false);
+            }
+            scan_locals(node->bin_operation_info.right, locals, position, false, false);
+            break;
+        case N_UN_OP:
+            if (node->un_operation_info.type == UNOP_GET_ADDR)
+                get_local(locals, node->un_operation_info.operand->variable_info.name)->eligible = false;
+            scan_locals(node->un_operation_info.operand, locals, position, false, false);
+            break;
+        case N_FUNC_CALL:
+            for (int64_t i = 0; i < node->func_call_info.param_count; ++i) {
+                scan_locals(node->func_call_info.params[i], locals, position, false, false);
+            }
+            break;
+        case N_IF:
+        case N_WHILE:
+            scan_locals(node->conditional_info.condition, locals, position, false, false);
+            scan_locals(node->conditional_info.statement, locals, position, true, false);
+            scan_locals(node->conditional_info.else_statement, locals, position, true, false);
+            break;
+        case N_COMPOUND:
+            for (size_t i = 0; i < node->compound_info.statement_amt; ++i) {
+                scan_locals(node->compound_info.statements[i], locals, position, true, false);
+            }
+            break;
+        case N_RETURN:
+            scan_locals(node->return_info.value, locals, position, false, false);
+            break;
+        default:
+            break;
+    }
+}
+
+// A local whose value is never read can lose all of its stores, as long as every store
+// is guaranteed to go to the local rather than to a global of the same name.
+static bool is_dead_local(Vector* locals, char* name) {
+    for (size_t i = 0; i < vector_size(locals); ++i) {
+        LocalInfo* info = vector_get(locals, i);
+        if (strcmp(info->name, name) != 0) continue;
+
+        return info->eligible && info->reads == 0 && info->defs == 1 && info->first_store > info->def_position;
+    }
+    return false;
+}
+
+// division can trap and dereferencing can fault, keep those to be safe
+static bool has_side_effects(ParseNode* node) {
+    if (node == NULL) return false;
+
+    switch (node->type) {
+        case N_NUMBER:
+        case N_STRING:
+        case N_VARIABLE:
+            return false;
+        case N_BIN_OP:
+            if (node->bin_operation_info.type == BINOP_ASSIGN || node->bin_operation_info.type == BINOP_DIV) return true;
+            return has_side_effects(node->bin_operation_info.left) || has_side_effects(node->bin_operation_info.right);
+        case N_UN_OP:
+            if (node->un_operation_info.type == UNOP_DEREF) return true;
+            return has_side_effects(node->un_operation_info.operand);
+        default:
+            return true;
+    }
+}
+
+// returns: what should still be evaluated of a removed store, or NULL if nothing
+static ParseNode* keep_side_effects(ParseNode* value) {
+    if (value == NULL || has_side_effects(value)) return value;
+    free_AST(value);
+    return NULL;
+}
+
+static ParseNode* new_empty_compound(int64_t line) {
+    ParseNode* result = malloc(sizeof(ParseNode));
+    result->type = N_COMPOUND;
+    result->line = line;
+    result->compound_info.statement_amt = 0;
+    result->compound_info.statements = NULL;
+    return result;
+}
+
+// returns: the statement to put in place of 'node', or NULL if it can be dropped
+static ParseNode* remove_dead_stores(ParseNode* node, Vector* locals, int64_t* removed) {
+    switch (node->type) {
+        case N_VAR_DEF: {
+            if (!is_dead_local(locals, node->var_def_info.name)) return node;
+
+            ParseNode* value = node->var_def_info.initial_val;
+            free(node->var_def_info.name);
+            free(node);
+            ++*removed;
+            return keep_side_effects(value);
+        }
+        case N_BIN_OP: {
+            ParseNode* target = node->bin_operation_info.left;
+            if (node->bin_operation_info.type != BINOP_ASSIGN || target->type != N_VARIABLE) return node;
+            if (!is_dead_local(locals, target->variable_info.name)) return node;
+
+            ParseNode* value = node->bin_operation_info.right;
+            free_AST(target);
+            free(node);
+            ++*removed;
+            return keep_side_effects(value);
+        }
+        case N_IF:
+        case N_WHILE: {
+            ParseNode* statement = remove_dead_stores(node->conditional_info.statement, locals, removed);
+            node->conditional_info.statement = statement == NULL ? new_empty_compound(node->line) : statement;
+
+            if (node->conditional_info.else_statement != NULL)
+                node->conditional_info.else_statement = remove_dead_stores(node->conditional_info.else_statement, locals, removed);
+            return node;
+        }
+        case N_COMPOUND: {
+            size_t kept = 0;
+            for (size_t i = 0; i < node->compound_info.statement_amt; ++i) {
+                ParseNode* statement = remove_dead_stores(node->compound_info.statements[i], locals, removed);
+                if (statement != NULL) node->compound_info.statements[kept++] = statement;
+            }
+            node->compound_info.statement_amt = kept;
+            return node;
+        }
+        default:
+            return node;
+    }
+}
+
+// returns: the amount of stores removed
+static int64_t remove_dead_stores_in_function(ParseNode* func_def, bool print_summary) {
+    Vector* locals = vector_new(10);
+
+    for (size_t i = 0; i < func_def->func_def_info->param_count; ++i) {
+        LocalInfo* info = get_local(locals, func_def->func_def_info->params[i]);
+        info->defs++;
+        info->def_position = -1;
+    }
+
+    ParseNode* body = func_def->func_def_info->statement;
+    for (size_t i = 0; i < body->compound_info.statement_amt; ++i) {
+        scan_locals(body->compound_info.statements[i], locals, i, true, true);
+    }
+
+    if (print_summary) {
+        for (size_t i = 0; i < vector_size(locals); ++i) {
+            LocalInfo* info = vector_get(locals, i);
+            if (is_dead_local(locals, info->name))
+                fprintf(stderr, "Removed stores to unused variable '%s' in function '%s'\n", info->name, func_def->func_def_info->name);
+        }
+    }
+
+    int64_t removed = 0;
+    remove_dead_stores(body, locals, &removed);
+
+    for (size_t i = 0; i < vector_size(locals); ++i) {
+        free(((LocalInfo*)vector_get(locals, i))->name);
+    }
+    vector_free(locals);
+    return removed;
+}
+
+void optimize_function(ParseNode* func_def) {
+    if (func_def->func_def_info->statement == NULL) return;
+
+    remove_dead_stores_in_function(func_def, false);
+    vectorize_loops(func_def);
+}
+
+void optimize_AST(ParseNode* root, bool print_summary) {
+    // the calls in a body that hasn't been parsed yet are unknown, so nothing can be called unreachable
+    bool all_parsed = true;
+    for (int64_t i = 0; i < root->root_info.count; ++i) {
+        ParseNode* definition = root->root_info.definitions[i];
+        if (definition->type == N_FUNC_DEF && definition->func_def_info->statement == NULL) all_parsed = false;
+    }
+
+    int64_t functions_removed = all_parsed ? remove_dead_functions(root, print_summary) : 0;
+
+    int64_t stores_removed = 0;
+    for (int64_t i = 0; i < root->root_info.count; ++i) {
+        ParseNode* definition = root->root_info.definitions[i];
+        if (definition->type == N_FUNC_DEF && definition->func_def_info->statement != NULL)
+            stores_removed += remove_dead_stores_in_function(definition, print_summary);
+    }
+
+    order_functions_by_profile(root);
+    vectorize_loops(root);
+
+    if (print_summary)
+        fprintf(stderr, "Removed " INT64_FORMAT " unused function(s) and " INT64_FORMAT " dead store(s)\n", functions_removed, stores_removed);
+}
@@ -0,0 +1,17 @@
+#ifndef _OPTIMIZER_H
+#define _OPTIMIZER_H
+
+#include "parser.h"
+
+#include <stdbool.h>
+
+// Rewrites the AST in place. Should be called once, between parsing and interpreting.
+// Removes unreachable functions and stores to unused locals, and turns simple array loops
+// into native kernels. Uses the counts of a loaded profile when profile_attach was called first.
+// print_summary: report what was removed on stderr
+void optimize_AST(ParseNode* root, bool print_summary);
+
+// optimizations that only need a single function, for bodies parsed after optimize_AST ran
+void optimize_function(ParseNode* func_def);
+
+#endif  // _OPTIMIZER_H
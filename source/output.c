@@ -0,0 +1,151 @@
+// for isatty and fileno
+#define _POSIX_C_SOURCE 200809L
+
+#include "output.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WINDOWS)
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+// enough for the digits of any 64 bit number and a sign
+#define MAX_NUMBER_LENGTH 21
+
+static char buffer[OUTPUT_BUFFER_SIZE];
+static size_t buffered = 0;
+static bool flush_lines = false;
+static bool flush_always = false;
+
+// two digits at a time halves the amount of divisions
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+void output_init(bool unbuffered) {
+    flush_always = unbuffered;
+    flush_lines = isatty(fileno(stdout));
+    atexit(output_flush);
+}
+
+void output_flush() {
+    if (buffered > 0) {
+        fwrite(buffer, 1, buffered, stdout);
+        buffered = 0;
+    }
+    fflush(stdout);
+}
+
+// flushes if the output that was just written should be visible right away
+static void written(bool ends_line) {
+    if (flush_always || (ends_line && flush_lines)) output_flush();
+}
+
+static void append(char* data, size_t length) {
+    if (length > OUTPUT_BUFFER_SIZE - buffered) {
+        output_flush();
+
+        // too large to be worth copying
+        if (length > OUTPUT_BUFFER_SIZE) {
+            fwrite(data, 1, length, stdout);
+            return;
+        }
+    }
+
+    memcpy(buffer + buffered, data, length);
+    buffered += length;
+}
+
+void output_char(char c) {
+    if (buffered == OUTPUT_BUFFER_SIZE) output_flush();
+    buffer[buffered++] = c;
+
+    written(c == '\n');
+}
+
+void output_string(char* string, size_t length) {
+    append(string, length);
+    written(memchr(string, '\n', length) != NULL);
+}
+
+// writes the digits right-aligned into 'end'
+// returns: start of the digits
+static char* format_uint(uint64_t value, char* end) {
+    char* start = end;
+
+    while (value >= 100) {
+        uint64_t pair = (value % 100) * 2;
+        value /= 100;
+        start -= 2;
+        start[0] = digit_pairs[pair];
+        start[1] = digit_pairs[pair + 1];
+    }
+
+    if (value >= 10) {
+        start -= 2;
+        start[0] = digit_pairs[value * 2];
+        start[1] = digit_pairs[value * 2 + 1];
+    } else {
+        *--start = '0' + value;
+    }
+
+    return start;
+}
+
+void output_uint_line(uint64_t value) {
+    char number[MAX_NUMBER_LENGTH + 1];
+    char* end = number + MAX_NUMBER_LENGTH;
+    *end = '\n';
+
+    char* start = format_uint(value, end);
+    append(start, end + 1 - start);
+    written(true);
+}
+
+// returns: start of the number, which ends with a newline at end[0]
+static char* format_int_line(int64_t value, char* end) {
+    *end = '\n';
+
+    // negated as unsigned, so INT64_MIN works as well
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    char* start = format_uint(magnitude, end);
+    if (value < 0) *--start = '-';
+    return start;
+}
+
+void output_int_line(int64_t value) {
+    char number[MAX_NUMBER_LENGTH + 1];
+    char* end = number + MAX_NUMBER_LENGTH;
+    char* start = format_int_line(value, end);
+
+    append(start, end + 1 - start);
+    written(true);
+}
+
+size_t output_format_int_line(int64_t value, char* buffer) {
+    char number[MAX_NUMBER_LENGTH + 1];
+    char* end = number + MAX_NUMBER_LENGTH;
+    char* start = format_int_line(value, end);
+
+    size_t length = end + 1 - start;
+    memcpy(buffer, start, length);
+    return length;
+}
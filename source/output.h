@@ -0,0 +1,35 @@
+#ifndef _OUTPUT_H
+#define _OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Output of the interpreted program. It is collected in a buffer and handed to stdout in
+// large blocks. When stdout is a terminal, every finished line is flushed, so interactive
+// programs look the same as before. The buffer is also flushed before reading input, before
+// errors are reported and at exit.
+
+// unbuffered: flush after every write
+void output_init(bool unbuffered);
+
+void output_char(char c);
+
+void output_string(char* string, size_t length);
+
+// writes the number followed by a newline
+void output_int_line(int64_t value);
+
+// writes the number followed by a newline
+void output_uint_line(uint64_t value);
+
+void output_flush();
+
+// room needed by output_format_int_line: a sign, 20 digits and the newline
+#define OUTPUT_MAX_INT_LINE 22
+
+// formats the number followed by a newline the way output_int_line writes it
+// returns: amount of characters written to 'buffer'
+size_t output_format_int_line(int64_t value, char* buffer);
+
+#endif  // _OUTPUT_H
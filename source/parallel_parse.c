@@ -0,0 +1,189 @@
+#include "parallel_parse.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helperfunctions.h"
+#include "vector/vector.h"
+
+// below this a chunk isn't worth handing to another thread
+#define MIN_CHUNK_SIZE (16 * 1024)
+// more chunks than threads, so a few long functions don't leave the other threads idle
+#define CHUNKS_PER_THREAD 4
+
+typedef struct Chunk {
+    char* start;
+    char* end;
+    int first_line;
+    TokenLL* tokens;
+    ParseNode* root;
+} Chunk;
+
+typedef struct ChunkQueue {
+    Chunk** chunks;
+    size_t chunk_amt;
+    bool lazy_bodies;
+    atomic_size_t next;
+} ChunkQueue;
+
+static bool starts_definition(char* word, char* word_end) {
+    size_t length = word_end - word;
+    return (length == 4 && strncmp(word, "func", 4) == 0) ||
+           (length == 3 && strncmp(word, "var", 3) == 0);
+}
+
+static void add_chunk(Vector* chunks, char* start, char* end, int first_line) {
+    Chunk* chunk = malloc(sizeof(Chunk));
+    chunk->start = start;
+    chunk->end = end;
+    chunk->first_line = first_line;
+    chunk->tokens = NULL;
+    chunk->root = NULL;
+    vector_push(chunks, chunk);
+}
+
+// Splits the text in front of 'func' and 'var' keywords outside of braces, once a chunk has
+// reached 'target_size'. Skips strings and comments the way the tokenizer does, so a split
+// never lands inside a token
+static Vector* split_at_definitions(char* text, size_t target_size) {
+    Vector* chunks = vector_new(16);
+
+    char* chunk_start = text;
+    int chunk_line = 1;
+    int line = 1;
+    int64_t depth = 0;
+
+    char* c = text;
+    while (*c != EOF) {
+        if (*c == '\n') {
+            ++line;
+            ++c;
+        } else if (*c == '"') {
+            // strings end at the line, an unterminated one is reported by the tokenizer
+            ++c;
+            while (*c != EOF && *c != '"' && *c != '\n') ++c;
+            if (*c == '"') ++c;
+        } else if (c[0] == '/' && c[1] == '/') {
+            while (*c != EOF && *c != '\n') ++c;
+        } else if (*c == '{') {
+            ++depth;
+            ++c;
+        } else if (*c == '}') {
+            --depth;
+            ++c;
+        } else if (is_identifier_char(*c)) {
+            char* word = c;
+            while (is_identifier_char(*c)) ++c;
+
+            if (depth == 0 && (size_t)(word - chunk_start) >= target_size && starts_definition(word, c)) {
+                add_chunk(chunks, chunk_start, word, chunk_line);
+                chunk_start = word;
+                chunk_line = line;
+            }
+        } else {
+            ++c;
+        }
+    }
+
+    add_chunk(chunks, chunk_start, c, chunk_line);
+    return chunks;
+}
+
+static void* parse_chunks(void* arg) {
+    ChunkQueue* queue = arg;
+
+    size_t i;
+    while ((i = atomic_fetch_add(&queue->next, 1)) < queue->chunk_amt) {
+        Chunk* chunk = queue->chunks[i];
+        tokenize_range(chunk->start, chunk->end, chunk->first_line, &chunk->tokens);
+        chunk->root = parse(chunk->tokens, queue->lazy_bodies);
+    }
+
+    return NULL;
+}
+
+ParseNode* parse_parallel(char* text, size_t text_size, int64_t thread_count, bool lazy_bodies, TokenLL** tokens) {
+    if (thread_count < 1) thread_count = 1;
+
+    size_t target_size = text_size / (thread_count * CHUNKS_PER_THREAD);
+    if (target_size < MIN_CHUNK_SIZE) target_size = MIN_CHUNK_SIZE;
+
+    Vector* chunks = split_at_definitions(text, target_size);
+
+    ChunkQueue queue;
+    queue.chunk_amt = vector_size(chunks);
+    queue.chunks = malloc(sizeof(Chunk*) * queue.chunk_amt);
+    for (size_t i = 0; i < queue.chunk_amt; ++i) {
+        queue.chunks[i] = vector_get(chunks, i);
+    }
+    vector_free_shallow(chunks);
+    queue.lazy_bodies = lazy_bodies;
+    atomic_init(&queue.next, 0);
+
+    size_t worker_amt = (size_t)thread_count < queue.chunk_amt ? (size_t)thread_count : queue.chunk_amt;
+
+    // the calling thread takes chunks as well, so one thread fewer is started
+    pthread_t* workers = malloc(sizeof(pthread_t) * worker_amt);
+    size_t started = 0;
+    for (size_t i = 1; i < worker_amt; ++i) {
+        // if a thread can't be started, the remaining chunks are simply taken by the others
+        if (pthread_create(&workers[started], NULL, parse_chunks, &queue) != 0) break;
+        ++started;
+    }
+
+    parse_chunks(&queue);
+
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    // merging the chunks in source order
+    int64_t definition_amt = 0;
+    for (size_t i = 0; i < queue.chunk_amt; ++i) {
+        definition_amt += queue.chunks[i]->root->root_info.count;
+    }
+
+    ParseNode* result = (ParseNode*)malloc(sizeof(ParseNode));
+    result->type = N_ROOT;
+    result->line = 0;
+    result->root_info.count = definition_amt;
+    result->root_info.definitions = malloc(sizeof(ParseNode*) * (definition_amt + 1));
+
+    *tokens = (TokenLL*)malloc(sizeof(TokenLL));
+    (*tokens)->head = NULL;
+    (*tokens)->tail = NULL;
+
+    int64_t next_definition = 0;
+    for (size_t i = 0; i < queue.chunk_amt; ++i) {
+        Chunk* chunk = queue.chunks[i];
+
+        ParseNode* root = chunk->root;
+        for (int64_t j = 0; j < root->root_info.count; ++j) {
+            result->root_info.definitions[next_definition++] = root->root_info.definitions[j];
+        }
+        free(root->root_info.definitions);
+        free(root);
+
+        // a chunk without tokens has no valid tail
+        if (chunk->tokens->head != NULL) {
+            if ((*tokens)->head == NULL)
+                (*tokens)->head = chunk->tokens->head;
+            else
+                (*tokens)->tail->next = chunk->tokens->head;
+            (*tokens)->tail = chunk->tokens->tail;
+        }
+        free(chunk->tokens);
+        free(chunk);
+    }
+    (*tokens)->current = (*tokens)->head;
+
+    free(queue.chunks);
+
+    return result;
+}
@@ -0,0 +1,19 @@
+#ifndef _PARALLEL_PARSE_H
+#define _PARALLEL_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parser.h"
+#include "tokenizer.h"
+
+// Tokenizes and parses a whole file on up to 'thread_count' threads. The text is split in
+// front of top-level definitions, every chunk is handled on its own and the definitions are
+// put back together in source order, so the result is the same tree parse would build.
+// Small files are handled on the calling thread.
+// text_size: length of the text without the EOF marker, only used to size the chunks
+// tokens: receives the tokens of the whole file, in order
+ParseNode* parse_parallel(char* text, size_t text_size, int64_t thread_count, bool lazy_bodies, TokenLL** tokens);
+
+#endif  // _PARALLEL_PARSE_H
@@ -1,11 +1,11 @@
 #include "parser.h"
 
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "helperfunctions.h"
+#include "output.h"
 #include "tokenizer.h"
 #include "vector/vector.h"
 #include "xplatform.h"
@@ -33,22 +33,41 @@ char* un_op_node_type_to_string[] = {
     "UNOP_GET_ADDR",
 };
 
+char* vec_loop_kind_to_string[] = {
+    "VEC_FILL",
+    "VEC_COPY",
+    "VEC_BINOP",
+    "VEC_REDUCE",
+};
+
+_Static_assert(sizeof(ParseNode) <= 40, "large node payloads belong out of line, see ParseNode");
+
+// set by parse, see parse_function_body. Thread local for parse_parallel
+static _Thread_local bool lazy_body_parsing = false;
+
 static void advance_token(TokenLL* tokens) {
     if (tokens->current == NULL) return;
     tokens->current = tokens->current->next;
 }
 
 static void panic(char* message, int64_t line) {
+    // with --lazy, bodies are parsed while the program runs
+    output_flush();
     fprintf(stderr, "Parser error on line " INT64_FORMAT ": %s\n", line, message);
     exit(1);
 }
 
-static void expect_token_type(TokenLL* tokens, int64_t expected_type) {
+// only complains about the end of the token stream, not about the type of the current token
+static void expect_more_tokens(TokenLL* tokens, int64_t expected_type) {
     if (tokens->current == NULL) {
         char buffer[100];
         snprintf(buffer, 100, "Expected token type %s, but found end of tokens instead", token_type_to_name[expected_type]);
         panic(buffer, tokens->tail->line);
     }
+}
+
+static void expect_token_type(TokenLL* tokens, int64_t expected_type) {
+    expect_more_tokens(tokens, expected_type);
 
     if (tokens->current->type != expected_type) {
         char buffer[100];
@@ -82,12 +101,14 @@ static ParseNode* get_function_call(TokenLL* tokens) {
 
     expect_token_type(tokens, T_LPAREN);
 
-    Vector* func_params = vector_new(10);  // initial size of 10, quite arbitrary
+    // most calls have few enough arguments to stay in the inline storage
+    Vector func_params;
+    vector_init(&func_params, sizeof(ParseNode*));
 
     if (tokens->current->next->type != T_RPAREN) {
         do {
             advance_token(tokens);
-            vector_push(func_params, get_expression(tokens));
+            vector_push(&func_params, get_expression(tokens));
         } while (tokens->current->type == T_COMMA);
     } else {
         advance_token(tokens);
@@ -100,13 +121,11 @@ static ParseNode* get_function_call(TokenLL* tokens) {
     result->type = N_FUNC_CALL;
     result->line = line;
     result->func_call_info.name = name;
-    result->func_call_info.param_count = vector_size(func_params);
-    result->func_call_info.params = malloc(sizeof(ParseNode*) * vector_size(func_params));
-    for (size_t i = 0; i < vector_size(func_params); ++i) {
-        result->func_call_info.params[i] = (ParseNode*)vector_get(func_params, i);
-    }
+    result->func_call_info.param_count = vector_size(&func_params);
+    result->func_call_info.params = malloc(sizeof(ParseNode*) * vector_size(&func_params));
+    memcpy(result->func_call_info.params, vector_data(&func_params), sizeof(ParseNode*) * vector_size(&func_params));
 
-    vector_free_shallow(func_params);
+    vector_deinit(&func_params);
 
     return result;
 }
@@ -185,7 +204,7 @@ static ParseNode* get_factor(TokenLL* tokens) {
 
         advance_token(tokens);
 
-        ParseNode* result = malloc(sizeof(ParseNode*));
+        ParseNode* result = malloc(sizeof(ParseNode));
         result->type = N_VARIABLE;
         result->line = line;
         result->variable_info.name = name;
@@ -262,7 +281,7 @@ static ParseNode* get_factor(TokenLL* tokens) {
         char* name = malloc(sizeof(char) * str_length);
         strcpy(name, tokens->current->string);
 
-        ParseNode* operand = malloc(sizeof(ParseNode*));
+        ParseNode* operand = malloc(sizeof(ParseNode));
         operand->type = N_VARIABLE;
         operand->line = tokens->current->line;
         operand->variable_info.name = name;
@@ -288,96 +307,72 @@ static ParseNode* get_factor(TokenLL* tokens) {
     return NULL;
 }
 
-#define HIGHEST_OP_PRECEDENCE 5
+// Binary operators by token type. A precedence of 0 means the token isn't a binary operator,
+// all operators are left associative
+static const int8_t binop_precedence[] = {
+    [T_ASSIGN] = 1,
 
-static int64_t get_token_type_precedence(TokenLL* tokens) {
-    switch (tokens->current->type) {
-        case T_ASSIGN:
-            return 1;
-        case T_EQUAL:
-        case T_LESS:
-        case T_LEQUAL:
-        case T_GREATER:
-        case T_GEQUAL:
-            return 2;
-
-        case T_AMPERSAND:
-        case T_PIPE:
-        case T_DBL_GREATER:
-        case T_DBL_LESS:
-            return 3;
-
-        case T_PLUS:
-        case T_MINUS:
-            return 4;
-
-        case T_ASTERISK:
-        case T_SLASH:;
-            static_assert(HIGHEST_OP_PRECEDENCE == 5);
-            return 5;
-    }
+    [T_EQUAL] = 2,
+    [T_LESS] = 2,
+    [T_LEQUAL] = 2,
+    [T_GREATER] = 2,
+    [T_GEQUAL] = 2,
 
-    return -1;
-}
+    [T_AMPERSAND] = 3,
+    [T_PIPE] = 3,
+    [T_DBL_GREATER] = 3,
+    [T_DBL_LESS] = 3,
 
-static int64_t binop_token_to_binop_type(int64_t binop_token) {
-    switch (binop_token) {
-        // 1:
-        case T_ASSIGN:
-            return BINOP_ASSIGN;
-
-        // 2:
-        case T_EQUAL:
-            return BINOP_EQUAL;
-        case T_LESS:
-            return BINOP_LESS;
-        case T_LEQUAL:
-            return BINOP_LEQUAL;
-        case T_GREATER:
-            return BINOP_GREATER;
-        case T_GEQUAL:
-            return BINOP_GEQUAL;
-
-        // 3:
-        case T_AMPERSAND:
-            return BINOP_BITAND;
-        case T_PIPE:
-            return BINOP_BITOR;
-        case T_DBL_GREATER:
-            return BINOP_SHRIGHT;
-        case T_DBL_LESS:
-            return BINOP_SHLEFT;
-
-        // 4:
-        case T_PLUS:
-            return BINOP_ADD;
-        case T_MINUS:
-            return BINOP_SUB;
-
-        // 5:
-        case T_ASTERISK:
-            return BINOP_MUL;
-        case T_SLASH:
-            return BINOP_DIV;
-    }
+    [T_PLUS] = 4,
+    [T_MINUS] = 4,
 
-    return -1;
-}
+    [T_ASTERISK] = 5,
+    [T_SLASH] = 5,
+
+    [T_STRING] = 0,  // sizes the table to cover every token type
+};
+
+static const enum BinOpNodeType binop_token_to_binop_type[] = {
+    [T_ASSIGN] = BINOP_ASSIGN,
+
+    [T_EQUAL] = BINOP_EQUAL,
+    [T_LESS] = BINOP_LESS,
+    [T_LEQUAL] = BINOP_LEQUAL,
+    [T_GREATER] = BINOP_GREATER,
+    [T_GEQUAL] = BINOP_GEQUAL,
+
+    [T_AMPERSAND] = BINOP_BITAND,
+    [T_PIPE] = BINOP_BITOR,
+    [T_DBL_GREATER] = BINOP_SHRIGHT,
+    [T_DBL_LESS] = BINOP_SHLEFT,
+
+    [T_PLUS] = BINOP_ADD,
+    [T_MINUS] = BINOP_SUB,
 
-static ParseNode* get_expression_recursive(int64_t precedence, TokenLL* tokens) {
-    // there are no more binary operators to check, get the factor
-    if (precedence > HIGHEST_OP_PRECEDENCE) return get_factor(tokens);
+    [T_ASTERISK] = BINOP_MUL,
+    [T_SLASH] = BINOP_DIV,
 
-    ParseNode* result = get_expression_recursive(precedence + 1, tokens);
+    [T_STRING] = 0,
+};
+
+static int64_t get_token_type_precedence(TokenLL* tokens) {
+    if (tokens->current == NULL) return 0;
+    return binop_precedence[tokens->current->type];
+}
 
-    while (tokens->current != NULL && get_token_type_precedence(tokens) == precedence) {
-        enum BinOpNodeType type = binop_token_to_binop_type(tokens->current->type);
-        d_assert((int)type != -1);
+// Precedence climbing: parses a factor, then keeps folding in operators that bind at least as
+// tightly as 'min_precedence'. The right hand side only takes operators that bind tighter,
+// which makes every level left associative
+static ParseNode* get_expression_with_precedence(int64_t min_precedence, TokenLL* tokens) {
+    ParseNode* result = get_factor(tokens);
 
+    int64_t precedence;
+    while ((precedence = get_token_type_precedence(tokens)) >= min_precedence) {
+        enum BinOpNodeType type = binop_token_to_binop_type[tokens->current->type];
         int64_t line = tokens->current->line;
 
         advance_token(tokens);
-        ParseNode* rhs = get_expression_recursive(precedence + 1, tokens);
+        ParseNode* rhs = get_expression_with_precedence(precedence + 1, tokens);
 
         ParseNode* binop = malloc(sizeof(ParseNode));
         binop->type = N_BIN_OP;
@@ -393,7 +388,7 @@ static ParseNode* get_expression_recursive(int64_t precedence, TokenLL* tokens)
 }
 
 static ParseNode* get_expression(TokenLL* tokens) {
-    return get_expression_recursive(0, tokens);
+    return get_expression_with_precedence(1, tokens);
 }
 
 static ParseNode* get_statement(TokenLL* tokens) {
@@ -454,6 +449,7 @@ static ParseNode* get_statement(TokenLL* tokens) {
         result->conditional_info.condition = condition;
         result->conditional_info.statement = statement;
         result->conditional_info.else_statement = else_statement;
+        result->conditional_info.profile = NULL;
 
         return result;
     }
@@ -464,10 +460,11 @@ static ParseNode* get_statement(TokenLL* tokens) {
 
         advance_token(tokens);
 
-        Vector* statements = vector_new(10);
+        Vector statements;
+        vector_init(&statements, sizeof(ParseNode*));
 
         while (tokens->current != NULL && tokens->current->type != T_RBRACE) {
-            vector_push(statements, get_statement(tokens));
+            vector_push(&statements, get_statement(tokens));
         }
 
         expect_token_type(tokens, T_RBRACE);
@@ -476,14 +473,11 @@ static ParseNode* get_statement(TokenLL* tokens) {
         ParseNode* result = (ParseNode*)malloc(sizeof(ParseNode));
         result->type = N_COMPOUND;
         result->line = line;
-        result->compound_info.statement_amt = vector_size(statements);
-        result->compound_info.statements = malloc(sizeof(ParseNode*) * vector_size(statements));
+        result->compound_info.statement_amt = vector_size(&statements);
+        result->compound_info.statements = malloc(sizeof(ParseNode*) * vector_size(&statements));
+        memcpy(result->compound_info.statements, vector_data(&statements), sizeof(ParseNode*) * vector_size(&statements));
 
-        for (size_t i = 0; i < vector_size(statements); ++i) {
-            result->compound_info.statements[i] = (ParseNode*)vector_get(statements, i);
-        }
-
-        vector_free_shallow(statements);
+        vector_deinit(&statements);
 
         return result;
     }
@@ -498,6 +492,7 @@ static ParseNode* get_statement(TokenLL* tokens) {
         if (tokens->current->type == T_SEMICOLON) {
             value = malloc(sizeof(ParseNode));
             value->type = N_NUMBER;
+            value->line = line;
             value->number_info.value = 0;
         } else {
             value = get_expression(tokens);
@@ -520,6 +515,22 @@ static ParseNode* get_statement(TokenLL* tokens) {
     return result;
 }
 
+// moves past a block without parsing it, only matching braces
+// returns: the first token of the block
+static Token* skip_block(TokenLL* tokens) {
+    Token* start = tokens->current;
+    int64_t depth = 0;
+
+    do {
+        expect_more_tokens(tokens, T_RBRACE);
+        if (tokens->current->type == T_LBRACE) ++depth;
+        if (tokens->current->type == T_RBRACE) --depth;
+        advance_token(tokens);
+    } while (depth > 0);
+
+    return start;
+}
+
 static ParseNode* get_function_definition(TokenLL* tokens) {
     expect_keyword(tokens, K_FUNC);
     int64_t line = tokens->current->line;
@@ -533,7 +544,8 @@ static ParseNode* get_function_definition(TokenLL* tokens) {
 
     expect_token_type(tokens, T_LPAREN);
 
-    Vector* func_params = vector_new(10);
+    Vector func_params;
+    vector_init(&func_params, sizeof(char*));
 
     if (tokens->current->next->type == T_IDENTIFIER) {
         do {
@@ -544,7 +556,7 @@ static ParseNode* get_function_definition(TokenLL* tokens) {
             char* name = malloc(sizeof(char) * param_len);
             strcpy(name, tokens->current->string);
 
-            vector_push(func_params, name);
+            vector_push(&func_params, name);
 
             advance_token(tokens);
 
@@ -557,20 +569,26 @@ static ParseNode* get_function_definition(TokenLL* tokens) {
     advance_token(tokens);
     expect_token_type(tokens, T_LBRACE);  // expect a compound statement
 
-    ParseNode* statement = get_statement(tokens);
+    ParseNode* statement = NULL;
+    Token* lazy_body = NULL;
+    if (lazy_body_parsing)
+        lazy_body = skip_block(tokens);
+    else
+        statement = get_statement(tokens);
 
     ParseNode* result = (ParseNode*)malloc(sizeof(ParseNode));
     result->type = N_FUNC_DEF;
     result->line = line;
-    result->func_def_info.name = identifier_name;
-    result->func_def_info.statement = statement;
-    result->func_def_info.param_count = vector_size(func_params);
-    result->func_def_info.params = malloc(sizeof(char*) * vector_size(func_params));
-    for (size_t i = 0; i < vector_size(func_params); ++i) {
-        result->func_def_info.params[i] = vector_get(func_params, i);
-    }
+    result->func_def_info = malloc(sizeof(FuncDefNode));
+    result->func_def_info->name = identifier_name;
+    result->func_def_info->statement = statement;
+    result->func_def_info->profile = NULL;
+    result->func_def_info->lazy_body = lazy_body;
+    result->func_def_info->param_count = vector_size(&func_params);
+    result->func_def_info->params = malloc(sizeof(char*) * vector_size(&func_params));
+    memcpy(result->func_def_info->params, vector_data(&func_params), sizeof(char*) * vector_size(&func_params));
 
-    vector_free_shallow(func_params);
+    vector_deinit(&func_params);
 
     return result;
 }
@@ -612,7 +630,21 @@ static ParseNode* get_variable_definition(TokenLL* tokens) {
     return result;
 }
 
-ParseNode* parse(TokenLL* tokens) {
+void parse_function_body(ParseNode* func_def) {
+    if (func_def->func_def_info->lazy_body == NULL) return;
+
+    // braces were matched when the body was skipped, so parsing stops before the end of the tokens
+    TokenLL tokens;
+    tokens.head = func_def->func_def_info->lazy_body;
+    tokens.tail = func_def->func_def_info->lazy_body;
+    tokens.current = func_def->func_def_info->lazy_body;
+
+    func_def->func_def_info->statement = get_statement(&tokens);
+    func_def->func_def_info->lazy_body = NULL;
+}
+
+ParseNode* parse(TokenLL* tokens, bool lazy_bodies) {
+    lazy_body_parsing = lazy_bodies;
     Vector* definitions = vector_new(10);
 
     while (tokens->current != NULL &&
@@ -639,9 +671,7 @@ ParseNode* parse(TokenLL* tokens) {
     result->root_info.count = vector_size(definitions);
     result->root_info.definitions = malloc(sizeof(ParseNode*) * vector_size(definitions));
 
-    for (size_t i = 0; i < vector_size(definitions); ++i) {
-        result->root_info.definitions[i] = (ParseNode*)vector_get(definitions, i);
-    }
+    memcpy(result->root_info.definitions, vector_data(definitions), sizeof(ParseNode*) * vector_size(definitions));
 
     vector_free_shallow(definitions);
 
@@ -658,40 +688,43 @@ void free_AST(ParseNode* node) {
         case N_ROOT:;
             int64_t count = node->root_info.count;
             for (int64_t i = 0; i < count; ++i) {
-                free(node->root_info.definitions[i]);
+                free_AST(node->root_info.definitions[i]);
             }
             free(node->root_info.definitions);
             break;
         case N_FUNC_DEF:
-            for (size_t i = 0; i < node->func_def_info.param_count; ++i) {
-                free(node->func_def_info.params[i]);
+            for (size_t i = 0; i < node->func_def_info->param_count; ++i) {
+                free(node->func_def_info->params[i]);
             }
-            free(node->func_def_info.params);
-            free(node->func_def_info.name);
-            free(node->func_def_info.statement);
+            free(node->func_def_info->params);
+            free(node->func_def_info->name);
+            if (node->func_def_info->statement != NULL)
+                free_AST(node->func_def_info->statement);
+            free(node->func_def_info);
             break;
         case N_VAR_DEF:
             free(node->var_def_info.name);
-            free(node->var_def_info.initial_val);
+            if (node->var_def_info.initial_val != NULL)
+                free_AST(node->var_def_info.initial_val);
             break;
         case N_ARR_DEF:
             free(node->arr_def_info.name);
-            free(node->arr_def_info.size);
+            free_AST(node->arr_def_info.size);
             break;
         case N_FUNC_CALL:
             for (int64_t i = 0; i < node->func_call_info.param_count; ++i) {
-                free(node->func_call_info.params[i]);
+                free_AST(node->func_call_info.params[i]);
             }
             free(node->func_call_info.params);
 
             free(node->func_call_info.name);
             break;
         case N_BIN_OP:
-            free(node->bin_operation_info.left);
-            free(node->bin_operation_info.right);
+            free_AST(node->bin_operation_info.left);
+            free_AST(node->bin_operation_info.right);
             break;
         case N_UN_OP:
-            free(node->un_operation_info.operand);
+            free_AST(node->un_operation_info.operand);
             break;
         case N_NUMBER:
             break;
@@ -705,10 +738,12 @@ void free_AST(ParseNode* node) {
         case N_WHILE:
             free_AST(node->conditional_info.condition);
             free_AST(node->conditional_info.statement);
+            if (node->conditional_info.else_statement != NULL)
+                free_AST(node->conditional_info.else_statement);
             break;
         case N_COMPOUND:
             for (size_t i = 0; i < node->compound_info.statement_amt; ++i) {
-                free(node->compound_info.statements[i]);
+                free_AST(node->compound_info.statements[i]);
             }
 
             free(node->compound_info.statements);
@@ -717,6 +752,10 @@ void free_AST(ParseNode* node) {
         case N_RETURN:
             free_AST(node->return_info.value);
             break;
+        case N_VEC_LOOP:
+            free_AST(node->vec_loop_info->fallback);
+            free(node->vec_loop_info);
+            break;
 #ifdef DEBUG
         case N_DEBUG:
             break;
@@ -758,18 +797,23 @@ void print_AST(ParseNode* node, int64_t indent) {
             printf("Function definition {\n");
 
             print_indent(indent + 1);
-            printf("Name: %s\n", node->func_def_info.name);
+            printf("Name: %s\n", node->func_def_info->name);
 
             print_indent(indent + 1);
             printf("Params [\n");
-            for (size_t i = 0; i < node->func_def_info.param_count; ++i) {
+            for (size_t i = 0; i < node->func_def_info->param_count; ++i) {
                 print_indent(indent + 2);
-                printf("%s\n", node->func_def_info.params[i]);
+                printf("%s\n", node->func_def_info->params[i]);
             }
             print_indent(indent + 1);
             printf("]\n");
 
-            print_AST(node->func_def_info.statement, indent + 1);
+            if (node->func_def_info->statement != NULL) {
+                print_AST(node->func_def_info->statement, indent + 1);
+            } else {
+                print_indent(indent + 1);
+                printf("Body not parsed yet\n");
+            }
 
             print_indent(indent);
             printf("}\n");
@@ -937,6 +981,26 @@ void print_AST(ParseNode* node, int64_t indent) {
             printf("}\n");
             break;
         }
+        case N_VEC_LOOP: {
+            print_indent(indent);
+            printf("Vectorized loop {\n");
+            print_indent(indent + 1);
+            printf("Kind: %s\n", vec_loop_kind_to_string[node->vec_loop_info->kind]);
+            if (node->vec_loop_info->kind == VEC_BINOP || node->vec_loop_info->kind == VEC_REDUCE) {
+                print_indent(indent + 1);
+                printf("Type: %s\n", bin_op_node_type_to_string[node->vec_loop_info->op]);
+            }
+
+            print_indent(indent + 1);
+            printf("Fallback {\n");
+            print_AST(node->vec_loop_info->fallback, indent + 2);
+            print_indent(indent + 1);
+            printf("}\n");
+
+            print_indent(indent);
+            printf("}\n");
+            break;
+        }
 #ifdef DEBUG
         case N_DEBUG: {
             print_indent(indent);
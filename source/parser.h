@@ -21,6 +21,7 @@ enum ParseNodeTypes {
     N_WHILE,
     N_COMPOUND,
     N_RETURN,
+    N_VEC_LOOP,
 #ifdef DEBUG
     N_DEBUG
 #endif
@@ -51,8 +52,10 @@ enum UnOpNodeType {
 
 extern char* bin_op_node_type_to_string[];
 extern char* un_op_node_type_to_string[];
+extern char* vec_loop_kind_to_string[];
 
 typedef struct ParseNode ParseNode;
+typedef struct NodeProfile NodeProfile;  // see profile.h
 
 typedef struct RootNode {
     int64_t count;
@@ -61,9 +64,11 @@ typedef struct RootNode {
 
 typedef struct FuncDefNode {
     char* name;
-    ParseNode* statement;
+    ParseNode* statement;  // NULL until parse_function_body is called if the body was skipped
     size_t param_count;
     char** params;
+    NodeProfile* profile;  // NULL unless profiling
+    Token* lazy_body;      // first token of a skipped body, NULL once parsed
 } FuncDefNode;
 
 typedef struct VarDefNode {
@@ -110,6 +115,7 @@ typedef struct ConditionalNode {
     ParseNode* condition;
     ParseNode* statement;
     ParseNode* else_statement;  // only used in if-statements
+    NodeProfile* profile;       // NULL unless profiling
 } ConditionalNode;
 
 typedef struct CompoundStatement {
@@ -121,18 +127,44 @@ typedef struct ReturnStatement {
     ParseNode* value;
 } ReturnStatement;
 
+enum VecLoopKind {
+    VEC_FILL,    // dest[i] = lhs
+    VEC_COPY,    // dest[i] = lhs[i]
+    VEC_BINOP,   // dest[i] = lhs op rhs, where at least one of them is indexed by i
+    VEC_REDUCE,  // dest = dest op lhs[i]
+};
+
+// A while loop that the optimizer recognised as an array idiom, run as a native kernel.
+// All child nodes are borrowed from 'fallback', which is the original while loop.
+// The fallback is interpreted instead whenever the kernel can't be used safely.
+typedef struct VecLoopNode {
+    enum VecLoopKind kind;
+    enum BinOpNodeType op;  // only used by VEC_BINOP and VEC_REDUCE
+    ParseNode* index;       // loop counter variable
+    ParseNode* limit;       // variable or number
+    ParseNode* dest;        // array variable, or accumulator variable for VEC_REDUCE
+    ParseNode* lhs;         // variable or number
+    ParseNode* rhs;         // variable or number, only used by VEC_BINOP
+    bool lhs_is_array;
+    bool rhs_is_array;
+    ParseNode* fallback;
+} VecLoopNode;
+
 #ifdef DEBUG
 typedef struct DebugStatement {
     int64_t number;
 } DebugStatement;
 #endif
 
+// Kept small so that expression trees stay dense: the line fits next to the type, and the
+// payloads of function definitions and vector loops, which are large but rare, live in a
+// separate allocation owned by the node.
 struct ParseNode {
     enum ParseNodeTypes type;
-    int64_t line;
+    int32_t line;
     union {
         RootNode root_info;
-        FuncDefNode func_def_info;
+        FuncDefNode* func_def_info;
         VarDefNode var_def_info;
         ArrDefNode arr_def_info;
         FuncCallNode func_call_info;
@@ -144,13 +176,19 @@ struct ParseNode {
         ConditionalNode conditional_info;
         CompoundStatement compound_info;
         ReturnStatement return_info;
+        VecLoopNode* vec_loop_info;
 #ifdef DEBUG
         DebugStatement debug_info;
 #endif
     };
 };
 
-ParseNode* parse(TokenLL* tokens);
+// lazy_bodies: only match the braces of function bodies, they are parsed on demand by
+// parse_function_body. The tokens have to be kept around until then
+ParseNode* parse(TokenLL* tokens, bool lazy_bodies);
+
+// parses a body skipped by parse, does nothing if it has been parsed already
+void parse_function_body(ParseNode* func_def);
 void print_AST(ParseNode* node, int64_t indent);
 void free_AST(ParseNode* node);
 
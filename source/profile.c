@@ -0,0 +1,206 @@
+#include "profile.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "tokenizer.h"
+#include "vector/vector.h"
+#include "xplatform.h"
+
+#define PROFILE_HEADER "CEQPROFILE 1"
+
+typedef struct ProfileRecord {
+    char kind;       // 'F' for functions, 'I' for if statements, 'W' for while loops
+    char* function;  // name of the function, or of the enclosing function
+    int64_t line;
+    int64_t seq;     // tells apart statements of the same kind on the same line
+    NodeProfile counts;
+} ProfileRecord;
+
+static Vector* records = NULL;         // everything attached to the current tree
+static ProfileRecord** loaded = NULL;  // sorted, for lookups while attaching
+static size_t loaded_amt = 0;
+
+static int compare_records(const void* a, const void* b) {
+    const ProfileRecord* left = *(ProfileRecord* const*)a;
+    const ProfileRecord* right = *(ProfileRecord* const*)b;
+
+    if (left->kind != right->kind) return left->kind - right->kind;
+
+    int cmp = strcmp(left->function, right->function);
+    if (cmp != 0) return cmp;
+
+    if (left->line != right->line) return left->line < right->line ? -1 : 1;
+    if (left->seq != right->seq) return left->seq < right->seq ? -1 : 1;
+    return 0;
+}
+
+static ProfileRecord* new_record(char kind, char* function, int64_t line, int64_t seq) {
+    ProfileRecord* record = malloc(sizeof(ProfileRecord));
+    record->kind = kind;
+    record->function = malloc(sizeof(char) * (strlen(function) + 1));
+    strcpy(record->function, function);
+    record->line = line;
+    record->seq = seq;
+    record->counts.executions = 0;
+    record->counts.hits = 0;
+    return record;
+}
+
+static void free_record(ProfileRecord* record) {
+    free(record->function);
+    free(record);
+}
+
+static void free_loaded() {
+    for (size_t i = 0; i < loaded_amt; ++i) {
+        free_record(loaded[i]);
+    }
+    free(loaded);
+    loaded = NULL;
+    loaded_amt = 0;
+}
+
+bool profile_load(char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return false;
+
+    char line_buffer[MAX_IDENTIFIER_LENGTH + 100];
+    if (fgets(line_buffer, sizeof(line_buffer), file) == NULL || strncmp(line_buffer, PROFILE_HEADER, strlen(PROFILE_HEADER)) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    free_loaded();
+    Vector* result = vector_new(100);
+
+    bool success = true;
+    while (fgets(line_buffer, sizeof(line_buffer), file) != NULL) {
+        char kind;
+        char function[MAX_IDENTIFIER_LENGTH];
+        int64_t line, seq, executions, hits;
+
+        // the width has to stay below MAX_IDENTIFIER_LENGTH
+        int matched = sscanf(line_buffer, "%c %999s " INT64_FORMAT " " INT64_FORMAT " " INT64_FORMAT " " INT64_FORMAT,
+                             &kind, function, &line, &seq, &executions, &hits);
+        if (matched != 6 || (kind != 'F' && kind != 'I' && kind != 'W')) {
+            success = false;
+            break;
+        }
+
+        ProfileRecord* record = new_record(kind, function, line, seq);
+        record->counts.executions = executions;
+        record->counts.hits = hits;
+        vector_push(result, record);
+    }
+
+    fclose(file);
+
+    if (!success) {
+        for (size_t i = 0; i < vector_size(result); ++i) {
+            free_record(vector_get(result, i));
+        }
+        vector_free_shallow(result);
+        return false;
+    }
+
+    loaded_amt = vector_size(result);
+    loaded = malloc(sizeof(ProfileRecord*) * (loaded_amt + 1));
+    for (size_t i = 0; i < loaded_amt; ++i) {
+        loaded[i] = vector_get(result, i);
+    }
+    vector_free_shallow(result);
+
+    qsort(loaded, loaded_amt, sizeof(ProfileRecord*), compare_records);
+    return true;
+}
+
+static NodeProfile* attach_record(char kind, char* function, int64_t line, size_t function_start) {
+    // count earlier statements of the same kind on the same line in this function
+    int64_t seq = 0;
+    for (size_t i = function_start; i < vector_size(records); ++i) {
+        ProfileRecord* other = vector_get(records, i);
+        if (other->kind == kind && other->line == line) ++seq;
+    }
+
+    ProfileRecord* record = new_record(kind, function, line, seq);
+
+    if (loaded != NULL) {
+        ProfileRecord** match = bsearch(&record, loaded, loaded_amt, sizeof(ProfileRecord*), compare_records);
+        if (match != NULL) record->counts = (*match)->counts;
+    }
+
+    vector_push(records, record);
+    return &record->counts;
+}
+
+static void attach_statements(ParseNode* node, char* function, size_t function_start) {
+    switch (node->type) {
+        case N_IF:
+        case N_WHILE:
+            node->conditional_info.profile = attach_record(node->type == N_IF ? 'I' : 'W', function, node->line, function_start);
+            attach_statements(node->conditional_info.statement, function, function_start);
+            if (node->conditional_info.else_statement != NULL)
+                attach_statements(node->conditional_info.else_statement, function, function_start);
+            break;
+        case N_COMPOUND:
+            for (size_t i = 0; i < node->compound_info.statement_amt; ++i) {
+                attach_statements(node->compound_info.statements[i], function, function_start);
+            }
+            break;
+        case N_VEC_LOOP:
+            attach_statements(node->vec_loop_info->fallback, function, function_start);
+            break;
+        default:
+            break;
+    }
+}
+
+void profile_attach(ParseNode* root) {
+    if (records == NULL) records = vector_new(100);
+
+    for (int64_t i = 0; i < root->root_info.count; ++i) {
+        ParseNode* definition = root->root_info.definitions[i];
+        if (definition->type != N_FUNC_DEF) continue;
+
+        char* name = definition->func_def_info->name;
+        size_t function_start = vector_size(records);
+        definition->func_def_info->profile = attach_record('F', name, definition->line, function_start);
+        if (definition->func_def_info->statement != NULL)
+            attach_statements(definition->func_def_info->statement, name, function_start);
+    }
+
+    // everything that was needed has been copied over
+    free_loaded();
+}
+
+bool profile_write(char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+
+    fprintf(file, PROFILE_HEADER "\n");
+
+    size_t count = records == NULL ? 0 : vector_size(records);
+    for (size_t i = 0; i < count; ++i) {
+        ProfileRecord* record = vector_get(records, i);
+        fprintf(file, "%c %s " INT64_FORMAT " " INT64_FORMAT " " INT64_FORMAT " " INT64_FORMAT "\n",
+                record->kind, record->function, record->line, record->seq, record->counts.executions, record->counts.hits);
+    }
+
+    return fclose(file) == 0;
+}
+
+void profile_free() {
+    free_loaded();
+
+    if (records == NULL) return;
+    for (size_t i = 0; i < vector_size(records); ++i) {
+        free_record(vector_get(records, i));
+    }
+    vector_free_shallow(records);
+    records = NULL;
+}
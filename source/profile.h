@@ -0,0 +1,31 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parser.h"
+
+// Execution counts for a function, if statement or while loop.
+// Records are keyed by the name of the enclosing function and the line of the node, so a
+// profile written by one run can be loaded by a later run of the same script.
+struct NodeProfile {
+    int64_t executions;  // times the function was called, or the statement was run
+    int64_t hits;        // times the if condition held, or the total amount of loop iterations
+};
+
+// reads a profile written by profile_write, to be used by the next call to profile_attach
+// returns: success or not
+bool profile_load(char* path);
+
+// gives every function, if statement and while loop in the tree a NodeProfile, starting from
+// the counts of a loaded profile if there is one. Bodies that haven't been parsed are skipped
+void profile_attach(ParseNode* root);
+
+// writes the counts of everything attached to
+// returns: success or not
+bool profile_write(char* path);
+
+void profile_free();
+
+#endif  // _PROFILE_H
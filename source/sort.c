@@ -0,0 +1,229 @@
+// for sysconf
+#define _DEFAULT_SOURCE
+
+#include "sort.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(WINDOWS)
+#include <unistd.h>
+#endif
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define PASS_AMT (64 / RADIX_BITS)
+
+// below this, the histograms cost more than the passes save
+#define INSERTION_SORT_MAX 48
+
+// below this, starting threads costs more than they save
+#define PARALLEL_SORT_MIN (1 << 20)
+#define MAX_SORT_THREADS 8
+
+// flipping the sign bit makes signed keys sort like unsigned ones
+static size_t digit(int64_t key, size_t pass) {
+    return (((uint64_t)key ^ ((uint64_t)1 << 63)) >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+}
+
+static void insertion_sort(int64_t* keys, int64_t* values, int64_t n) {
+    for (int64_t i = 1; i < n; ++i) {
+        int64_t key = keys[i];
+        int64_t value = values != NULL ? values[i] : 0;
+        int64_t j = i;
+        for (; j > 0 && keys[j - 1] > key; --j) {
+            keys[j] = keys[j - 1];
+            if (values != NULL) values[j] = values[j - 1];
+        }
+        keys[j] = key;
+        if (values != NULL) values[j] = value;
+    }
+}
+
+// one slice of the array, handled by one thread
+typedef struct SortSlice {
+    const int64_t* keys;
+    const int64_t* values;
+    int64_t* keys_out;
+    int64_t* values_out;
+    int64_t start;
+    int64_t end;
+    size_t pass;
+    size_t counts[PASS_AMT][RADIX_SIZE];  // before the first pass: of every digit of every pass
+    size_t offsets[RADIX_SIZE];           // where the slice's keys of every digit go
+} SortSlice;
+
+static void* count_all_digits(void* argument) {
+    SortSlice* slice = argument;
+    const int64_t* keys = slice->keys;
+    memset(slice->counts, 0, sizeof(slice->counts));
+    for (int64_t i = slice->start; i < slice->end; ++i) {
+        for (size_t pass = 0; pass < PASS_AMT; ++pass) {
+            ++slice->counts[pass][digit(keys[i], pass)];
+        }
+    }
+    return NULL;
+}
+
+static void* count_digits(void* argument) {
+    SortSlice* slice = argument;
+    const int64_t* keys = slice->keys;
+    size_t pass = slice->pass;
+    size_t* counts = slice->counts[pass];
+    memset(counts, 0, sizeof(slice->counts[0]));
+    for (int64_t i = slice->start; i < slice->end; ++i) {
+        ++counts[digit(keys[i], pass)];
+    }
+    return NULL;
+}
+
+static void* scatter(void* argument) {
+    SortSlice* slice = argument;
+
+    // copied into locals, the stores into the output could otherwise alias them
+    size_t offsets[RADIX_SIZE];
+    memcpy(offsets, slice->offsets, sizeof(offsets));
+    const int64_t* keys = slice->keys;
+    const int64_t* values = slice->values;
+    int64_t* keys_out = slice->keys_out;
+    int64_t* values_out = slice->values_out;
+    size_t pass = slice->pass;
+
+    if (values == NULL) {
+        for (int64_t i = slice->start; i < slice->end; ++i) {
+            keys_out[offsets[digit(keys[i], pass)]++] = keys[i];
+        }
+    } else {
+        for (int64_t i = slice->start; i < slice->end; ++i) {
+            size_t target = offsets[digit(keys[i], pass)]++;
+            keys_out[target] = keys[i];
+            values_out[target] = values[i];
+        }
+    }
+    return NULL;
+}
+
+// runs 'task' for every slice, the calling thread takes the first one
+static void run_slices(void* (*task)(void*), SortSlice* slices, size_t amt) {
+    pthread_t threads[MAX_SORT_THREADS];
+    bool started[MAX_SORT_THREADS] = {false};
+
+    for (size_t i = 1; i < amt; ++i) {
+        started[i] = pthread_create(&threads[i], NULL, task, &slices[i]) == 0;
+    }
+    task(&slices[0]);
+
+    // a slice whose thread couldn't be started is done here
+    for (size_t i = 1; i < amt; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            task(&slices[i]);
+        }
+    }
+}
+
+static size_t thread_amt(int64_t n) {
+    if (n < PARALLEL_SORT_MIN) return 1;
+
+#if defined(WINDOWS)
+    return 1;
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) return 1;
+    return cpus > MAX_SORT_THREADS ? MAX_SORT_THREADS : (size_t)cpus;
+#endif
+}
+
+void sort_int64(int64_t* keys, int64_t* values, int64_t n) {
+    if (n <= INSERTION_SORT_MAX) {
+        insertion_sort(keys, values, n);
+        return;
+    }
+
+    size_t slice_amt = thread_amt(n);
+    SortSlice* slices = malloc(sizeof(SortSlice) * slice_amt);
+    for (size_t i = 0; i < slice_amt; ++i) {
+        slices[i].start = n * i / slice_amt;
+        slices[i].end = n * (i + 1) / slice_amt;
+        slices[i].keys = keys;
+    }
+
+    // the counts of all passes together show which bytes are the same in every key
+    run_slices(count_all_digits, slices, slice_amt);
+    bool needed[PASS_AMT];
+    for (size_t pass = 0; pass < PASS_AMT; ++pass) {
+        size_t total = 0;
+        for (size_t i = 0; i < slice_amt; ++i) total += slices[i].counts[pass][digit(keys[0], pass)];
+        needed[pass] = total != (size_t)n;
+    }
+
+    int64_t* keys_buffer = malloc(sizeof(int64_t) * n);
+    int64_t* values_buffer = values != NULL ? malloc(sizeof(int64_t) * n) : NULL;
+    int64_t* keys_in = keys;
+    int64_t* values_in = values;
+    int64_t* keys_out = keys_buffer;
+    int64_t* values_out = values_buffer;
+
+    bool first = true;
+    for (size_t pass = 0; pass < PASS_AMT; ++pass) {
+        if (!needed[pass]) continue;
+
+        for (size_t i = 0; i < slice_amt; ++i) {
+            slices[i].keys = keys_in;
+            slices[i].values = values_in;
+            slices[i].keys_out = keys_out;
+            slices[i].values_out = values_out;
+            slices[i].pass = pass;
+        }
+
+        // the keys have moved since they were counted, except before the first pass
+        if (!first) run_slices(count_digits, slices, slice_amt);
+        first = false;
+
+        // keys of a smaller digit come first, within a digit the keys of earlier slices
+        size_t offset = 0;
+        for (size_t d = 0; d < RADIX_SIZE; ++d) {
+            for (size_t i = 0; i < slice_amt; ++i) {
+                slices[i].offsets[d] = offset;
+                offset += slices[i].counts[pass][d];
+            }
+        }
+        run_slices(scatter, slices, slice_amt);
+
+        int64_t* swap = keys_in;
+        keys_in = keys_out;
+        keys_out = swap;
+        swap = values_in;
+        values_in = values_out;
+        values_out = swap;
+    }
+
+    // an odd amount of passes leaves the result in the buffers
+    if (keys_in != keys) {
+        memcpy(keys, keys_in, sizeof(int64_t) * n);
+        if (values != NULL) memcpy(values, values_in, sizeof(int64_t) * n);
+    }
+
+    free(keys_buffer);
+    free(values_buffer);
+    free(slices);
+}
+
+int64_t sort_search(const int64_t* keys, int64_t n, int64_t value) {
+    // the first key that isn't smaller than 'value'
+    int64_t low = 0;
+    int64_t high = n;
+    while (low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if (keys[middle] < value) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < n && keys[low] == value ? low : -1;
+}
@@ -0,0 +1,16 @@
+#ifndef _SORT_H
+#define _SORT_H
+
+#include <stdint.h>
+
+// Sorts 'n' keys in ascending order with an LSD radix sort, one byte per pass. Passes over
+// a byte that is the same in every key are skipped, so keys that only use a small range
+// take fewer passes. The sort is stable, and large arrays are sorted on several threads.
+// values: moved along with their keys, or NULL
+void sort_int64(int64_t* keys, int64_t* values, int64_t n);
+
+// keys: sorted in ascending order
+// returns: index of the first key equal to 'value', or -1
+int64_t sort_search(const int64_t* keys, int64_t n, int64_t value);
+
+#endif  // _SORT_H
@@ -6,7 +6,8 @@
 
 #include "helperfunctions.h"
 
-static int curr_line = 1;
+// thread local so chunks of a file can be tokenized in parallel
+static _Thread_local int curr_line = 1;
 
 char* token_type_to_name[] = {
     "T_HEAD",
@@ -158,6 +159,11 @@ static bool should_skip(char c) {
 }
 
 void tokenize(char* text, TokenLL** result) {
+    tokenize_range(text, NULL, 1, result);
+}
+
+void tokenize_range(char* text, char* end, int first_line, TokenLL** result) {
+    curr_line = first_line;
     *result = (TokenLL*)malloc(sizeof(TokenLL));
 
     Token* head = (Token*)malloc(sizeof(Token));
@@ -167,7 +173,7 @@ void tokenize(char* text, TokenLL** result) {
     (*result)->head = head;
     (*result)->tail = head;
 
-    while (*text != EOF) {
+    while (text != end && *text != EOF) {
         if (is_number(*text)) {
             create_number(&text, *result);
         } else if (is_identifier_char(*text)) {
@@ -389,10 +395,13 @@ void print_tokens(Token* node) {
 }
 
 void free_token(Token* node) {
-    if (node == NULL) return;
-    free_token(node->next);
-    if (node->type == T_IDENTIFIER || node->type == T_STRING) {
-        free(node->string);
+    // iterative, large files have more tokens than the stack has frames
+    while (node != NULL) {
+        Token* next = node->next;
+        if (node->type == T_IDENTIFIER || node->type == T_STRING) {
+            free(node->string);
+        }
+        free(node);
+        node = next;
     }
-    free(node);
 }
\ No newline at end of file
@@ -69,6 +69,9 @@ enum KeywordTypes {
 extern char* keyword_type_to_name[];
 
 void tokenize(char* text, TokenLL** result);
+// tokenizes until 'end', or until the EOF marker if 'end' is NULL. 'end' must not be in the
+// middle of a token, string or comment. Lines are counted from 'first_line'
+void tokenize_range(char* text, char* end, int first_line, TokenLL** result);
 void print_tokens(Token* node);
 void free_token(Token* node);
 